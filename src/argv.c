@@ -8,30 +8,94 @@
 #include <string.h>
 
 #include "argv.h"
+#include "cpu.h"
+#include "dump.h"
 #include "err.h"
+#include "romdb.h"
+#include "turbo.h"
+
+static const struct option _long_opts[] = {
+    {"profile",     no_argument,        NULL,   ARGV_PROFILE},
+    {"watch",       required_argument,  NULL,   ARGV_WATCH},
+    {"rwatch",      required_argument,  NULL,   ARGV_RWATCH},
+    {"awatch",      required_argument,  NULL,   ARGV_AWATCH},
+    {"trace",       required_argument,  NULL,   ARGV_TRACE},
+    {"rewind",      no_argument,        NULL,   ARGV_REWIND},
+    {"session",     required_argument,  NULL,   ARGV_SESSION},
+    {"dump",        required_argument,  NULL,   ARGV_DUMP},
+    {"speed",       required_argument,  NULL,   ARGV_SPEED},
+    {"quirks",      required_argument,  NULL,   ARGV_QUIRKS},
+    {"keymap",      required_argument,  NULL,   ARGV_KEYMAP},
+    {"romdb",       required_argument,  NULL,   ARGV_ROMDB},
+    {"adaptive",    no_argument,        NULL,   ARGV_ADAPTIVE},
+    {"vip-timing",  no_argument,        NULL,   ARGV_VIP_TIMING},
+    {"record",      required_argument,  NULL,   ARGV_RECORD},
+    {"shm",         required_argument,  NULL,   ARGV_SHM},
+    {"control",     required_argument,  NULL,   ARGV_CONTROL},
+    {"bench-startup", no_argument,      NULL,   ARGV_BENCH_STARTUP},
+    {"perf",        required_argument,  NULL,   ARGV_PERF},
+    {NULL,          0,                  NULL,   0}
+};
 
 void init_argv(Argv *this) {
     this->about             = false;
-    for (int i=0; i<16; i++) {
-        this->brkpts[i] = 0;
-    }
-    this->brkpts_len        = 0;
+    this->adaptive          = false;
+    this->bench_startup     = false;
+    init_brk(&this->brk);
     this->bg                = 0x000000;
     this->fg                = 0xffffff;
     this->clk_freq          = 500;
+    this->control           = NULL;
     this->debug             = false;
+    this->dump_fmt          = DUMP_HEX;
+    this->given             = 0;
     this->help              = false;
+    this->keymap            = NULL;
     this->svst              = NULL;
     this->mute              = false;
     this->paused            = false;
+    this->perf              = NULL;
+    this->profile           = false;
     this->pitch             = 880;
+    this->quirks            = QUIRK_K8E;
+    this->trace             = NULL;
     this->px_sz             = 8;
+    this->record            = NULL;
+    this->rewind            = false;
+    this->shm               = NULL;
+    this->romdb             = NULL;
+    this->speed             = 1;
+    this->vip_timing        = false;
+    this->sess              = NULL;
     this->fname             = NULL;
 }
 
+// Parse a watchpoint range, given as ADDR or ADDR-ADDR in hex.
+static void _parse_watch(Argv *this, int opt, char *arg, Err *err) {
+    char    *end;
+    long    lo      = strtol(arg, &end, 16);
+    long    hi      = lo;
+
+    if (end != arg && *end == '-') {
+        arg = end + 1;
+        hi = strtol(arg, &end, 16);
+    }
+    if (end == arg || *end != '\0' || lo < 0 || lo > hi ||
+            hi > ADDR_PROG_END) {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Watch range must be ADDR or "
+            "ADDR-ADDR in hex, up to %03x", ADDR_PROG_END);
+        return;
+    }
+    set_watch(&this->brk, lo, hi, opt != ARGV_WATCH, opt != ARGV_RWATCH);
+}
+
 void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
-    int curr_opt;
-    while ((curr_opt = getopt(argc, argv, ARGV_OPTSTR)) != -1) {
+    int     curr_opt;
+    long    speed;
+
+    while ((curr_opt = getopt_long(argc, argv, ARGV_OPTSTR, _long_opts,
+            NULL)) != -1) {
         switch (curr_opt) {
             
             case 'a':
@@ -39,26 +103,22 @@ void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
             break;
 
             case 'b':
-            if (this->brkpts_len >= ARGV_MAX_BRKPTS - 1) {
-                err->code = ERR_ARGV;
-                strcpy(err->msg, "Cannot set more than 16 breakpoints");
-                return;
-            }
-            this->brkpts[this->brkpts_len] = 
-                (uint16_t) strtol(optarg, NULL, 16);
-            this->brkpts_len++;
+            set_brk(&this->brk, (uint16_t) strtol(optarg, NULL, 16));
             break;
 
             case 'B':
             this->bg = (uint32_t) strtol(optarg, NULL, 16);
+            this->given |= ARGV_GIVEN_BG;
             break;
 
             case 'c':
             this->clk_freq = (uint32_t) strtol(optarg, NULL, 16);
+            this->given |= ARGV_GIVEN_FREQ;
             break;
 
             case 'F':
             this->fg = (uint32_t) strtol(optarg, NULL, 16);
+            this->given |= ARGV_GIVEN_FG;
             break;
 
             case 'h':
@@ -89,6 +149,102 @@ void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
             this->pitch = (uint16_t) strtol(optarg, NULL, 10);
             break;
 
+            case ARGV_PROFILE:
+            this->profile = true;
+            break;
+
+            case ARGV_WATCH:
+            case ARGV_RWATCH:
+            case ARGV_AWATCH:
+            _parse_watch(this, curr_opt, optarg, err);
+            if (is_err(err)) return;
+            break;
+
+            case ARGV_TRACE:
+            this->trace = optarg;
+            break;
+
+            case ARGV_REWIND:
+            this->rewind = true;
+            break;
+
+            case ARGV_SESSION:
+            this->sess = optarg;
+            break;
+
+            case ARGV_DUMP:
+            if (!get_dump_fmt(optarg, &this->dump_fmt)) {
+                err->code = ERR_ARGV;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "Unknown dump format %s",
+                    optarg);
+                return;
+            }
+            break;
+
+            case ARGV_SPEED:
+            speed = strtol(optarg, NULL, 10);
+            if (speed < 0 || speed > TURBO_MAX_SPEED) {
+                err->code = ERR_ARGV;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "Speed must be 0 "
+                    "(uncapped) to %d", TURBO_MAX_SPEED);
+                return;
+            }
+            this->speed = (uint8_t) speed;
+            break;
+
+            case ARGV_QUIRKS:
+            if (!get_quirk_prof(optarg, &this->quirks)) {
+                err->code = ERR_ARGV;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "Unknown quirk profile %s",
+                    optarg);
+                return;
+            }
+            this->given |= ARGV_GIVEN_QUIRKS;
+            break;
+
+            case ARGV_KEYMAP:
+            if (strlen(optarg) != ROM_KEYMAP_LEN) {
+                err->code = ERR_ARGV;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "Keymap must have %d keys",
+                    ROM_KEYMAP_LEN);
+                return;
+            }
+            this->keymap = optarg;
+            this->given |= ARGV_GIVEN_KEYMAP;
+            break;
+
+            case ARGV_ROMDB:
+            this->romdb = optarg;
+            break;
+
+            case ARGV_ADAPTIVE:
+            this->adaptive = true;
+            break;
+
+            case ARGV_VIP_TIMING:
+            this->vip_timing = true;
+            break;
+
+            case ARGV_RECORD:
+            this->record = optarg;
+            break;
+
+            case ARGV_SHM:
+            this->shm = optarg;
+            break;
+
+            case ARGV_CONTROL:
+            this->control = optarg;
+            break;
+
+            case ARGV_BENCH_STARTUP:
+            this->bench_startup = true;
+            break;
+
+            case ARGV_PERF:
+            this->perf = optarg;
+            break;
+
             case '?':
             err->code = ERR_ARGV;
             if (optopt == 'b' || optopt == 'B' || optopt == 'c' || 
@@ -98,6 +254,11 @@ void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
                     "argument", optopt);
                 return;
             }
+            if (optopt == 0) {
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "Unknown option %s",
+                    argv[optind - 1]);
+                return;
+            }
             snprintf(err->msg, MAX_ERR_MSG_LEN, "Unknown option -%c", optopt);
             return;
 
@@ -105,6 +266,16 @@ void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
             return;
         }
     }
+    if (this->rewind && this->sess != NULL) {
+        err->code = ERR_ARGV;
+        strcpy(err->msg, "A session cannot be recorded with --rewind");
+        return;
+    }
+    // A control server can be started without a ROM, to load one later
+    if (this->control != NULL && optind == argc) {
+        this->fname = NULL;
+        return;
+    }
     if (optind != argc - 1 && !(this->about || this->help)) {
         err->code = ERR_ARGV;
         snprintf(err->msg, MAX_ERR_MSG_LEN, "1 positional argument expected, "
@@ -113,3 +284,13 @@ void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err) {
     } 
     this->fname = argv[optind];
 }
+
+void apply_argv_rom(Argv *this, const RomEnt *ent) {
+    uint8_t take = ent->has & ~this->given;
+
+    if (take & ROM_HAS_FREQ) this->clk_freq = ent->clk_freq;
+    if (take & ROM_HAS_QUIRKS) this->quirks = ent->quirks;
+    if (take & ROM_HAS_KEYMAP) this->keymap = ent->keymap;
+    if (take & ROM_HAS_BG) this->bg = ent->bg;
+    if (take & ROM_HAS_FG) this->fg = ent->fg;
+}
@@ -0,0 +1,95 @@
+// Copyright (C) 2024  KA Wright
+
+// brk.c - Breakpoints and watchpoints
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "brk.h"
+#include "cpu.h"
+#include "ram.h"
+
+static inline bool _test_bit(const uint64_t *map, uint16_t addr) {
+    return (map[addr / 64] >> (addr % 64)) & 1;
+}
+
+// Return the first address of map set in the len bytes from addr, or
+// BRK_NO_ADDR if none are.
+static uint16_t _test_range(const uint64_t *map, uint16_t addr,
+        uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        if (_test_bit(map, (addr + i) & ADDR_PROG_END)) {
+            return (addr + i) & ADDR_PROG_END;
+        }
+    }
+    return BRK_NO_ADDR;
+}
+
+void init_brk(Brk *this) {
+    memset(this, 0, sizeof(Brk));
+    this->held = BRK_NO_ADDR;
+    this->hit_addr = BRK_NO_ADDR;
+}
+
+void set_brk(Brk *this, uint16_t addr) {
+    addr &= ADDR_PROG_END;
+    this->exec[addr / 64] |= (uint64_t) 1 << (addr % 64);
+    this->active = true;
+}
+
+void set_watch(Brk *this, uint16_t lo, uint16_t hi, bool rd, bool wr) {
+    for (uint32_t addr = lo; addr <= hi && addr <= ADDR_PROG_END; addr++) {
+        if (rd) this->rd[addr / 64] |= (uint64_t) 1 << (addr % 64);
+        if (wr) this->wr[addr / 64] |= (uint64_t) 1 << (addr % 64);
+    }
+    this->active = true;
+}
+
+bool is_brk(const Brk *this, uint16_t addr) {
+    return _test_bit(this->exec, addr & ADDR_PROG_END);
+}
+
+bool is_watched(const Brk *this, uint16_t addr, uint16_t len) {
+    return _test_range(this->wr, addr, len) != BRK_NO_ADDR;
+}
+
+BrkHit check_brk(Brk *this, const Cpu *cpu, const Ram *ram) {
+    uint16_t    pc          = cpu->pc & ADDR_PROG_END;
+    uint16_t    instr;
+    uint8_t     x;
+    BrkHit      hit         = BRK_HIT_NONE;
+
+    if (!this->active) return BRK_HIT_NONE;
+
+    // Let the instruction stopped at run once when execution resumes
+    if (pc == this->held) {
+        if (!cpu->paused) this->held = BRK_NO_ADDR;
+        return BRK_HIT_NONE;
+    }
+    this->held = BRK_NO_ADDR;
+    this->hit_addr = BRK_NO_ADDR;
+
+    instr = (ram->data[pc] << 8) + ram->data[(pc + 1) & ADDR_PROG_END];
+    x = (instr & 0x0f00) >> 8;
+    if (_test_bit(this->exec, pc)) {
+        hit = BRK_HIT_EXEC;
+    } else if ((instr & 0xf000) == 0xd000) {
+        this->hit_addr = _test_range(this->rd, cpu->i_reg, instr & 0xf);
+        hit = BRK_HIT_READ;
+    } else if ((instr & 0xf0ff) == 0xf065) {
+        this->hit_addr = _test_range(this->rd, cpu->i_reg, x + 1);
+        hit = BRK_HIT_READ;
+    } else if ((instr & 0xf0ff) == 0xf055) {
+        this->hit_addr = _test_range(this->wr, cpu->i_reg, x + 1);
+        hit = BRK_HIT_WRITE;
+    } else if ((instr & 0xf0ff) == 0xf033) {
+        this->hit_addr = _test_range(this->wr, cpu->i_reg, 3);
+        hit = BRK_HIT_WRITE;
+    }
+    if (hit != BRK_HIT_EXEC && this->hit_addr == BRK_NO_ADDR) {
+        return BRK_HIT_NONE;
+    }
+    this->held = pc;
+    return hit;
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2024  KA Wright
+
+// bundle.c - Indexed multi-ROM bundle files
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bundle.h"
+#include "err.h"
+#include "ram.h"
+
+void open_bundle(Bundle *this, const char *fname, Err *err) {
+    struct stat     st;
+    const BundleHdr *hdr;
+    const BundleEnt *ent;
+    size_t          data_off;
+    int             fd          = open(fname, O_RDONLY);
+
+    this->map = NULL;
+    this->len = 0;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    if ((size_t) st.st_size < sizeof(BundleHdr)) {
+        close(fd);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "%s is not a bundle", fname);
+        return;
+    }
+    this->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (this->map == MAP_FAILED) {
+        this->map = NULL;
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not map file %s", fname);
+        return;
+    }
+    this->map_sz = st.st_size;
+
+    // Check the header, that every entry's ROM lies within the file past the
+    // table, and that names are in order, as find_bundle searches them
+    hdr = (const BundleHdr *) this->map;
+    if (memcmp(hdr->magic, BUNDLE_MAGIC, sizeof(hdr->magic)) != 0 ||
+            hdr->ver != BUNDLE_VER || hdr->ent_sz != sizeof(BundleEnt) ||
+            hdr->len > (this->map_sz - sizeof(BundleHdr)) /
+            sizeof(BundleEnt)) {
+        close_bundle(this);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "%s is not a version %d bundle",
+            fname, BUNDLE_VER);
+        return;
+    }
+    this->ents = (const BundleEnt *) (this->map + sizeof(BundleHdr));
+    this->len = hdr->len;
+    data_off = sizeof(BundleHdr) + (size_t) this->len * sizeof(BundleEnt);
+    for (uint32_t i = 0; i < this->len; i++) {
+        ent = &this->ents[i];
+        if (ent->off < data_off || ent->off > this->map_sz ||
+                ent->len > this->map_sz - ent->off ||
+                memchr(ent->name, '\0', MAX_BUNDLE_NAME_LEN) == NULL ||
+                (i > 0 && strncmp(this->ents[i - 1].name, ent->name,
+                MAX_BUNDLE_NAME_LEN) >= 0)) {
+            close_bundle(this);
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Bad entry %u in %s", i,
+                fname);
+            return;
+        }
+    }
+}
+
+void close_bundle(Bundle *this) {
+    if (this->map != NULL) {
+        munmap((void *) this->map, this->map_sz);
+    }
+    this->map = NULL;
+    this->ents = NULL;
+    this->len = 0;
+}
+
+int64_t find_bundle(const Bundle *this, const char *name) {
+    uint32_t    lo      = 0;
+    uint32_t    hi      = this->len;
+    uint32_t    mid;
+    int         cmp;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        cmp = strncmp(name, this->ents[mid].name, MAX_BUNDLE_NAME_LEN);
+        if (cmp == 0) return mid;
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return -1;
+}
+
+void ld_ram_bundle(Ram *this, const Bundle *bundle, uint32_t idx, Err *err) {
+    if (idx >= bundle->len) {
+        err->code = ERR_RANGE;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "No bundle entry %u", idx);
+        return;
+    }
+    ld_ram_buf(this, bundle->map + bundle->ents[idx].off,
+        bundle->ents[idx].len, err);
+}
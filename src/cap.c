@@ -0,0 +1,96 @@
+// Copyright (C) 2024  KA Wright
+
+// cap.c - Framebuffer video capture
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cap.h"
+#include "err.h"
+#include "ring.h"
+#include "vid.h"
+
+// Encode one queued framebuffer into fp, on the writer thread. Return data
+// indicates if the write succeeded.
+static bool _enc_frame(FILE *fp, const void *rec, void *ctx) {
+    Cap             *this       = ctx;
+    const uint64_t  *rows       = rec;
+    uint16_t        w           = VID_W * this->scale;
+    uint16_t        h           = VID_H * this->scale;
+    size_t          len         = this->fmt == CAP_PBM ? w / 8 : w;
+    uint16_t        px;
+    bool            on;
+    bool            ok          = true;
+
+    if (this->fmt == CAP_Y4M) {
+        if (this->frames == 0) {
+            fprintf(fp, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 Cmono\n", w, h);
+        }
+        fprintf(fp, "FRAME\n");
+    } else {
+        fprintf(fp, this->fmt == CAP_PGM ? "P5\n%u %u\n255\n" : "P4\n%u %u\n",
+            w, h);
+    }
+    for (uint8_t y = 0; y < VID_H && ok; y++) {
+
+        // PBM packs 8 pixels a byte, with 1 for black
+        if (this->fmt == CAP_PBM) memset(this->line, 0, len);
+        for (uint8_t x = 0; x < VID_W; x++) {
+            on = (rows[y] >> (VID_W - 1 - x)) & 1;
+            if (this->fmt != CAP_PBM) {
+                memset(this->line + x * this->scale, on ? 0xff : 0,
+                    this->scale);
+                continue;
+            }
+            for (uint8_t i = 0; i < this->scale && !on; i++) {
+                px = x * this->scale + i;
+                this->line[px >> 3] |= 0x80 >> (px & 7);
+            }
+        }
+        for (uint8_t i = 0; i < this->scale && ok; i++) {
+            ok = fwrite(this->line, len, 1, fp) == 1;
+        }
+    }
+    this->frames++;
+    return ok && ferror(fp) == 0;
+}
+
+void open_cap(Cap *this, const char *fname, uint8_t scale, Err *err) {
+    const char *ext = strrchr(fname, '.');
+
+    if (ext != NULL && strcmp(ext, ".y4m") == 0) {
+        this->fmt = CAP_Y4M;
+    } else if (ext != NULL && strcmp(ext, ".pgm") == 0) {
+        this->fmt = CAP_PGM;
+    } else if (ext != NULL && strcmp(ext, ".pbm") == 0) {
+        this->fmt = CAP_PBM;
+    } else {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Unknown capture format for %s "
+            "(use .y4m, .pgm or .pbm)", fname);
+        return;
+    }
+    if (scale == 0 || scale > MAX_CAP_SCALE) {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Capture scale must be 1 to %d",
+            MAX_CAP_SCALE);
+        return;
+    }
+    this->scale = scale;
+    this->frames = 0;
+    this->dropped = 0;
+    open_ring_enc(&this->ring, fname, CAP_RING_SZ, VID_H * sizeof(uint64_t),
+        _enc_frame, this, err);
+}
+
+void close_cap(Cap *this, Err *err) {
+    close_ring(&this->ring, err);
+    if (!is_err(err) && this->dropped > 0) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Capture dropped %u of %llu "
+            "frames", this->dropped, (unsigned long long) (this->frames +
+            this->dropped));
+    }
+}
@@ -0,0 +1,273 @@
+// Copyright (C) 2024  KA Wright
+
+// cfg.c - Static control-flow graph of a ROM
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "dis.h"
+#include "err.h"
+#include "ram.h"
+
+#define CFG_NO_I                0xffff
+#define CFG_MAX_WORK            (2 * (ADDR_PROG_END + 1))
+
+// Stores an address still to be walked, and the I register on arrival.
+typedef struct __CFG_WORK__ {
+    uint16_t    addr;
+    uint16_t    i_reg;
+} CfgWork;
+
+static inline uint16_t _fetch(const Ram *ram, uint16_t addr) {
+    return (ram->data[addr] << 8) + ram->data[addr + 1];
+}
+
+static inline bool _is_skip(OpCls cls) {
+    return cls == OP_SE_BYTE || cls == OP_SNE_BYTE || cls == OP_SE_REG ||
+        cls == OP_SNE_REG || cls == OP_SKP || cls == OP_SKNP;
+}
+
+static void _mark(Cfg *this, uint16_t lo, uint16_t len, uint8_t flag) {
+    for (uint16_t i = 0; i < len; i++) {
+        this->flags[(lo + i) & ADDR_PROG_END] |= flag;
+    }
+}
+
+static void _push(Cfg *this, CfgWork *work, uint16_t *len, uint16_t addr,
+        uint16_t i_reg) {
+    addr &= ADDR_PROG_END;
+    this->flags[addr] |= CFG_LEADER;
+    if ((this->flags[addr] & CFG_CODE) == 0 && *len < CFG_MAX_WORK) {
+        work[(*len)++] = (CfgWork) {addr, i_reg};
+    }
+}
+
+// Walk straight-line code from one address, marking what it touches, until
+// an instruction which ends a block.
+static void _walk(Cfg *this, const Ram *ram, CfgWork from, CfgWork *work,
+        uint16_t *len) {
+    uint16_t    addr        = from.addr;
+    uint16_t    i_reg       = from.i_reg;
+    uint16_t    instr;
+    uint16_t    nnn;
+    uint8_t     x;
+    OpCls       cls;
+
+    while (addr >= ADDR_PROG_START && addr < ADDR_PROG_END &&
+            (this->flags[addr] & CFG_CODE) == 0) {
+        this->flags[addr] |= CFG_CODE;
+        instr = _fetch(ram, addr);
+        cls = get_op_cls(instr);
+        nnn = instr & 0xfff;
+        x = (instr >> 8) & 0xf;
+
+        switch (cls) {
+
+            case OP_JP:
+            _push(this, work, len, nnn, i_reg);
+            return;
+
+            case OP_CALL:
+            this->flags[nnn] |= CFG_CALLED;
+            _push(this, work, len, nnn, i_reg);
+            _push(this, work, len, addr + 2, CFG_NO_I);
+            return;
+
+            case OP_RET:
+            return;
+
+            case OP_JP_V0:
+            this->flags[addr] |= CFG_COMPUTED;
+            return;
+
+            case OP_LD_I:
+            i_reg = nnn;
+            break;
+
+            case OP_ADD_I:
+            case OP_LD_F:
+            i_reg = CFG_NO_I;
+            break;
+
+            case OP_DRW:
+            if (i_reg != CFG_NO_I) _mark(this, i_reg, instr & 0xf, CFG_DATA);
+            break;
+
+            case OP_LD_MEM_GET:
+            if (i_reg != CFG_NO_I) _mark(this, i_reg, x + 1, CFG_DATA);
+            break;
+
+            case OP_LD_B:
+            case OP_LD_MEM_SET:
+            if (i_reg == CFG_NO_I) {
+                this->flags[addr] |= CFG_WR_ANY;
+            } else {
+                _mark(this, i_reg, cls == OP_LD_B ? 3 : x + 1, CFG_WRITTEN);
+            }
+            break;
+
+            default:
+            break;
+        }
+        if (_is_skip(cls)) {
+            _push(this, work, len, addr + 2, i_reg);
+            _push(this, work, len, addr + 4, i_reg);
+            return;
+        }
+        addr += 2;
+    }
+}
+
+// Split the walked code into blocks, in address order.
+static void _split(Cfg *this, const Ram *ram) {
+    CfgBlk      *blk;
+    uint16_t    instr;
+    uint16_t    end;
+    OpCls       cls;
+
+    this->blks_len = 0;
+    for (uint16_t addr = ADDR_PROG_START; addr < ADDR_PROG_END; addr++) {
+        if ((this->flags[addr] & (CFG_CODE | CFG_LEADER)) !=
+                (CFG_CODE | CFG_LEADER)) {
+            continue;
+        }
+        blk = &this->blks[this->blks_len++];
+        blk->start = addr;
+        blk->succ[0] = CFG_NO_SUCC;
+        blk->succ[1] = CFG_NO_SUCC;
+        end = addr;
+        while (true) {
+            instr = _fetch(ram, end);
+            cls = get_op_cls(instr);
+            end += 2;
+            if (cls == OP_JP) {
+                blk->succ[0] = instr & 0xfff;
+                break;
+            }
+            if (cls == OP_CALL) {
+                blk->succ[0] = instr & 0xfff;
+                blk->succ[1] = end;
+                break;
+            }
+            if (cls == OP_RET || cls == OP_JP_V0) break;
+            if (_is_skip(cls)) {
+                blk->succ[0] = end;
+                blk->succ[1] = end + 2;
+                break;
+            }
+            if (end >= ADDR_PROG_END || (this->flags[end] & CFG_CODE) == 0) {
+                break;
+            }
+            if (this->flags[end] & CFG_LEADER) {
+                blk->succ[0] = end;
+                break;
+            }
+        }
+        blk->end = end;
+    }
+}
+
+void build_cfg(Cfg *this, const Ram *ram) {
+    static CfgWork  work[CFG_MAX_WORK];
+    uint16_t        len         = 0;
+
+    memset(this->flags, 0, sizeof(this->flags));
+    this->hash = ram->hash;
+    _push(this, work, &len, ADDR_PROG_START, CFG_NO_I);
+    while (len > 0) {
+        len--;
+        _walk(this, ram, work[len], work, &len);
+    }
+    _split(this, ram);
+}
+
+int32_t find_cfg_blk(const Cfg *this, uint16_t addr) {
+    int32_t     lo          = 0;
+    int32_t     hi          = this->blks_len;
+    int32_t     mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (this->blks[mid].start == addr) return mid;
+        if (this->blks[mid].start < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+void sv_cfg(const Cfg *this, const char *fname, Err *err) {
+    CfgHdr  hdr         = {{0}, CFG_VER, this->blks_len, this->hash};
+    FILE    *fp         = fopen(fname, "wb");
+
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    memcpy(hdr.magic, CFG_MAGIC, sizeof(hdr.magic));
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(this->flags, sizeof(this->flags), 1, fp);
+    fwrite(this->blks, sizeof(CfgBlk), this->blks_len, fp);
+    if (ferror(fp)) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not write file %s", fname);
+    }
+    fclose(fp);
+}
+
+// Check that the blocks of a loaded Cfg are in range and sorted by start, as
+// find_cfg_blk needs. Return data indicates if so.
+static bool _is_cfg_ok(const Cfg *this) {
+    const CfgBlk *blk;
+
+    for (uint16_t i = 0; i < this->blks_len; i++) {
+        blk = &this->blks[i];
+        if (blk->start >= blk->end || blk->end > ADDR_PROG_END + 1 ||
+                (i > 0 && blk->start < this->blks[i - 1].end)) {
+            return false;
+        }
+        for (uint8_t j = 0; j < 2; j++) {
+            if (blk->succ[j] != CFG_NO_SUCC && blk->succ[j] > ADDR_PROG_END) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void ld_cfg(Cfg *this, const char *fname, Err *err) {
+    CfgHdr  hdr;
+    FILE    *fp         = fopen(fname, "rb");
+
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            memcmp(hdr.magic, CFG_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.ver != CFG_VER || hdr.blks_len > MAX_CFG_BLKS ||
+            fread(this->flags, sizeof(this->flags), 1, fp) != 1 ||
+            fread(this->blks, sizeof(CfgBlk), hdr.blks_len, fp) !=
+            hdr.blks_len) {
+        fclose(fp);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "%s is not a version %d analysis",
+            fname, CFG_VER);
+        return;
+    }
+    fclose(fp);
+    this->hash = hdr.hash;
+    this->blks_len = hdr.blks_len;
+    if (!_is_cfg_ok(this)) {
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Analysis %s has a corrupt block",
+            fname);
+    }
+}
@@ -9,26 +9,31 @@
 
 #include "clock.h"
 
-static uint64_t _get_micros() {
+uint64_t get_micros() {
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return tv.tv_sec * (uint64_t) 1000000 + tv.tv_usec;
 }
 
-void init_clk(Clk *this, uint16_t freq) {
+void init_clk(Clk *this, uint32_t freq) {
     this->freq = freq;
     this->ticks = 0;
     this->next_tick = 0;
 }
 
 void start_clk(Clk *this) {
+    if (this->freq == 0) return;
     uint64_t period = 1000000 / this->freq;
-    uint64_t micros = _get_micros();
+    uint64_t micros = get_micros();
     this->next_tick = micros + period;
 }
 
 bool update_clk(Clk *this) {
-    uint64_t micros = _get_micros();
+    if (this->freq == 0) {
+        this->ticks++;
+        return true;
+    }
+    uint64_t micros = get_micros();
     uint64_t period = 1000000 / this->freq;
     if (micros >= this->next_tick) {
         this->ticks++;
@@ -37,3 +42,16 @@ bool update_clk(Clk *this) {
     }
     return false;
 }
+
+void nap_clk(const Clk *this) {
+    struct timespec ts;
+    uint64_t        micros;
+
+    if (this->freq == 0) return;
+    micros = get_micros();
+    if (micros >= this->next_tick) return;
+    micros = this->next_tick - micros;
+    ts.tv_sec = micros / 1000000;
+    ts.tv_nsec = (micros % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
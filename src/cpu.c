@@ -2,15 +2,12 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "cpu.h"
 #include "err.h"
-#include "graphic.h"
-#include "key.h"
 #include "ram.h"
-#include "sound.h"
+#include "vid.h"
 
 void init_cpu(Cpu *this) {
     for (uint8_t i = 0; i < 16; i++) {
@@ -20,22 +17,27 @@ void init_cpu(Cpu *this) {
     this->i_reg = 0;
     this->del_timer = 0;
     this->snd_timer = 0;
-    this->pc = 0;
+    this->pc = ADDR_PROG_START;
     this->sp = 0;
     this->instr = 0;
+    this->rng = CPU_RNG_SEED;
+    this->quirks = QUIRK_K8E;
     this->paused = false;
     this->step = false; 
 }
 
-void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
+// Perform a single Cpu operation with the given QUIRK_* bits. It is always
+// inlined into a copy per profile, so the quirks are constants and each test
+// of them is resolved at compile time.
+static inline __attribute__((always_inline)) void _do_op(Cpu *this, Ram *ram,
+        Vid *vid, uint16_t keys, Err *err, const uint8_t quirks) {
     uint8_t     nib_a;
     uint8_t     nib_b;
     uint8_t     nib_c;
     uint8_t     nib_d;
     uint8_t     kk;
     uint16_t    nnn;
-    uint8_t     temp_reg;
-    uint8_t     temp_byte;
+    uint8_t     flag;
 
     if (this->paused && !this->step) {
         return;
@@ -44,6 +46,11 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
         this->step = false;
     }
 
+    if (this->pc >= ADDR_PROG_END) {
+        err->code = ERR_RANGE;
+        strcpy(err->msg, "Program counter out of range");
+        return;
+    }
     this->instr = (ram->data[this->pc] << 8) + ram->data[this->pc + 1];
 
     nib_a   = (this->instr & 0xf000) >> 12;
@@ -59,9 +66,7 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
         
         // 00e0 - CLS
         if (nnn == 0x0e0) {
-            clear_win(win, err);
-            if (is_err(err)) return;
-            redraw_win(win); 
+            clear_vid(vid);
             break;
         }
  
@@ -130,6 +135,7 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
         this->v_regs[nib_b] += kk;
         break;
 
+        // VF is written after Vx, so the flag survives when x is 0xf
         case 0x8:
         switch (nib_d) {
             
@@ -141,64 +147,60 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
             // 8xy1 - OR Vx, Vy
             case 0x1:
             this->v_regs[nib_b] |= this->v_regs[nib_c];
+            if (quirks & QUIRK_VF_RESET) this->v_regs[0xf] = 0;
             break;
 
             // 8xy2 - AND Vx, Vy
             case 0x2:
             this->v_regs[nib_b] &= this->v_regs[nib_c];
+            if (quirks & QUIRK_VF_RESET) this->v_regs[0xf] = 0;
             break;
 
             // 8xy3 - XOR Vx, Vy
             case 0x3:
             this->v_regs[nib_b] ^= this->v_regs[nib_c];
+            if (quirks & QUIRK_VF_RESET) this->v_regs[0xf] = 0;
             break;
 
             // 8xy4 - ADD Vx, Vy
             case 0x4:
-            if (this->v_regs[nib_b] + this->v_regs[nib_c] > 255) {
-                this->v_regs[0xf] = 1;
-            } else {
-                this->v_regs[0xf] = 0;
-            }
+            flag = (this->v_regs[nib_b] + this->v_regs[nib_c]) > 255;
             this->v_regs[nib_b] += this->v_regs[nib_c];
+            this->v_regs[0xf] = flag;
             break;
 
             // 8xy5 - SUB Vx, Vy
             case 0x5:
-            if (this->v_regs[nib_b] > this->v_regs[nib_c]) {
-                this->v_regs[0xf] = 1;
-            } else {
-                this->v_regs[0xf] = 0;
-            }
+            flag = this->v_regs[nib_b] >= this->v_regs[nib_c];
             this->v_regs[nib_b] -= this->v_regs[nib_c];
+            this->v_regs[0xf] = flag;
             break;
 
             // 8xy6 - SHR Vx, {Vy}
             case 0x6:
-            if ((this->v_regs[nib_b] & 1) == 1) {
-                this->v_regs[0xf] = 1;
+            if (quirks & QUIRK_SHIFT_VY) {
+                this->v_regs[nib_b] = this->v_regs[nib_c];
             }
+            flag = this->v_regs[nib_b] & 1;
             this->v_regs[nib_b] >>= 1;
+            this->v_regs[0xf] = flag;
             break;
 
             // 8xy7 - SUBN Vx, Vy
             case 0x7:
-            if (this->v_regs[nib_c] > this->v_regs[nib_b]) {
-                this->v_regs[0xf] = 1;
-            } else {
-                this->v_regs[0xf] = 0;
-            }
+            flag = this->v_regs[nib_c] >= this->v_regs[nib_b];
             this->v_regs[nib_b] = this->v_regs[nib_c] - this->v_regs[nib_b];
+            this->v_regs[0xf] = flag;
             break;
 
             // 8xye - SHL Vx, {Vy}
             case 0xe:
-            if ((this->v_regs[nib_b] & 0x80) == 0x80) {
-                this->v_regs[0xf] = 1;
-            } else {
-                this->v_regs[0xf] = 0;
+            if (quirks & QUIRK_SHIFT_VY) {
+                this->v_regs[nib_b] = this->v_regs[nib_c];
             }
+            flag = this->v_regs[nib_b] >> 7;
             this->v_regs[nib_b] <<= 1;
+            this->v_regs[0xf] = flag;
             break;
 
             // Illegal opcode
@@ -220,80 +222,32 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
         this->i_reg = nnn;
         break;
 
-        // bnnn - JP V0, addr
+        // bnnn - JP V0, addr (bxnn - JP Vx, addr with QUIRK_JP_VX)
         case 0xb:
-        this->pc += (this->v_regs[0] + nnn - 2);
+        this->pc = this->v_regs[quirks & QUIRK_JP_VX ? nib_b : 0] + nnn - 2;
         break;
 
         // cxkk - RND Vx, byte
         case 0xc:
-        this->v_regs[nib_b] = ((uint8_t) rand()) & kk;
+        this->rng ^= this->rng << 13;           // xorshift32
+        this->rng ^= this->rng >> 17;
+        this->rng ^= this->rng << 5;
+        this->v_regs[nib_b] = ((uint8_t) this->rng) & kk;
         break;
 
         // dxyn - DRW Vx, Vy, nibble
         case 0xd:
-        temp_reg = this->v_regs[nib_c];
-        this->v_regs[0xf] = 0;
-        for (uint16_t addr = this->i_reg; addr < (this->i_reg + nib_d); 
-                addr++) {
-            temp_byte = ram->data[addr]; 
-            if (temp_byte & 0x80) {
-                if (draw_px(win, this->v_regs[nib_b], temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x40) {
-                if (draw_px(win, this->v_regs[nib_b]+1, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x20) {
-                if (draw_px(win, this->v_regs[nib_b]+2, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x10) {
-                if (draw_px(win, this->v_regs[nib_b]+3, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x8) {
-                if (draw_px(win, this->v_regs[nib_b]+4, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x4) {
-                if (draw_px(win, this->v_regs[nib_b]+5, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x2) {
-                if (draw_px(win, this->v_regs[nib_b]+6, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            if (temp_byte & 0x1) {
-                if (draw_px(win, this->v_regs[nib_b]+7, temp_reg, err)) {
-                    this->v_regs[0xf] = 1;
-                }
-                if (is_err(err)) return;
-                redraw_win(win);
-            }
-            temp_reg++;
+        if ((this->i_reg + nib_d) > (ADDR_PROG_END + 1)) {
+            err->code = ERR_RANGE;
+            strcpy(err->msg, "Out-of-bounds RAM access.");
+            return;
+        }
+        if (quirks & QUIRK_CLIP) {
+            this->v_regs[0xf] = draw_vid_clip(vid, this->v_regs[nib_b],
+                this->v_regs[nib_c], ram->data + this->i_reg, nib_d);
+        } else {
+            this->v_regs[0xf] = draw_vid(vid, this->v_regs[nib_b],
+                this->v_regs[nib_c], ram->data + this->i_reg, nib_d);
         }
         break; 
 
@@ -302,14 +256,16 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
             
             // ex9e - SKP Vx
             case 0x9e:
-            if (read_key(key_st, this->v_regs[nib_b])) {
+            if (this->v_regs[nib_b] < 16 && 
+                    (keys >> this->v_regs[nib_b]) & 1) {
                 this->pc += 2;  
             }
             break;
 
             // exa1 - SKNP Vx
             case 0xa1:
-            if (!read_key(key_st, this->v_regs[nib_b])) {
+            if (!(this->v_regs[nib_b] < 16 && 
+                    (keys >> this->v_regs[nib_b]) & 1)) {
                 this->pc += 2;
             }
             break;
@@ -327,9 +283,17 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
             this->v_regs[nib_b] = this->del_timer;
             break;
 
-            // fx0a - LD Vx, K
+            // fx0a - LD Vx, K (Repeat until a key is down)
             case 0x0a:
-            this->v_regs[nib_b] = poll_key();
+            if (keys == 0) {
+                return;
+            }
+            for (uint8_t key = 0; key < 16; key++) {
+                if ((keys >> key) & 1) {
+                    this->v_regs[nib_b] = key;
+                    break;
+                }
+            }
             break;
 
             // fx15 - LD DT, Vx
@@ -445,6 +409,7 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
                 }
                 ram->data[this->i_reg+i] = this->v_regs[i];
             }
+            if (quirks & QUIRK_MEM_INC_I) this->i_reg += nib_b + 1;
             break;
 
             // fx65 - LD Vx, [I]
@@ -459,6 +424,7 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
                     return;
                 }
             }            
+            if (quirks & QUIRK_MEM_INC_I) this->i_reg += nib_b + 1;
             break;
 
             default:
@@ -473,3 +439,59 @@ void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err) {
 
     return;
 }
+
+// Instantiate the interpreter for one quirk profile.
+#define CPU_OP_PROF(name, quirks)                                           \
+    static void name(Cpu *this, Ram *ram, Vid *vid, uint16_t keys,          \
+            Err *err) {                                                     \
+        _do_op(this, ram, vid, keys, err, quirks);                          \
+    }
+
+CPU_OP_PROF(_do_op_k8e, QUIRKS_K8E)
+CPU_OP_PROF(_do_op_vip, QUIRKS_VIP)
+CPU_OP_PROF(_do_op_schip, QUIRKS_SCHIP)
+CPU_OP_PROF(_do_op_xochip, QUIRKS_XOCHIP)
+
+static void (*const _ops[QUIRK_PROF_LEN])(Cpu *, Ram *, Vid *, uint16_t,
+        Err *) = {
+    [QUIRK_K8E]     = _do_op_k8e,
+    [QUIRK_VIP]     = _do_op_vip,
+    [QUIRK_SCHIP]   = _do_op_schip,
+    [QUIRK_XOCHIP]  = _do_op_xochip
+};
+
+static const uint8_t _quirks[QUIRK_PROF_LEN] = {
+    [QUIRK_K8E]     = QUIRKS_K8E,
+    [QUIRK_VIP]     = QUIRKS_VIP,
+    [QUIRK_SCHIP]   = QUIRKS_SCHIP,
+    [QUIRK_XOCHIP]  = QUIRKS_XOCHIP
+};
+
+static const char *const _names[QUIRK_PROF_LEN] = {
+    [QUIRK_K8E]     = "k8e",
+    [QUIRK_VIP]     = "vip",
+    [QUIRK_SCHIP]   = "schip",
+    [QUIRK_XOCHIP]  = "xochip"
+};
+
+void do_cpu_op(Cpu *this, Ram *ram, Vid *vid, uint16_t keys, Err *err) {
+    _ops[this->quirks](this, ram, vid, keys, err);
+}
+
+bool get_quirk_prof(const char *name, QuirkProf *prof) {
+    for (uint8_t i = 0; i < QUIRK_PROF_LEN; i++) {
+        if (strcmp(name, _names[i]) == 0) {
+            *prof = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *get_quirk_name(QuirkProf prof) {
+    return _names[prof];
+}
+
+uint8_t get_quirks(QuirkProf prof) {
+    return _quirks[prof];
+}
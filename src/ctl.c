@@ -0,0 +1,375 @@
+// Copyright (C) 2024  KA Wright
+
+// ctl.c - Unix-socket control server
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ctl.h"
+#include "err.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+// Queue a reply to a client, with len bytes of body.
+static void _reply(CtlClient *cl, uint8_t op, const Err *err,
+        const void *body, uint32_t len) {
+    CtlResp resp;
+
+    if (is_err(err)) {
+        body = err->msg;
+        len = strlen(err->msg);
+    }
+    resp.op = op;
+    resp.code = err->code;
+    resp.pad = 0;
+    resp.len = len;
+    memcpy(cl->out, &resp, sizeof(resp));
+    if (len > 0) memcpy(cl->out + sizeof(resp), body, len);
+    cl->out_len = sizeof(resp) + len;
+    cl->out_off = 0;
+}
+
+// Handle the complete request at the start of a client's input.
+static void _handle(Ctl *this, CtlClient *cl) {
+    CtlReq          req;
+    const uint8_t   *body       = cl->in + sizeof(req);
+    Vm              *vm         = this->vm;
+    Cpu             *cpu        = &vm->cpu;
+    QuirkProf       quirks      = cpu->quirks;
+    Err             err;
+
+    memcpy(&req, cl->in, sizeof(req));
+    init_err(&err);
+    this->stats.reqs++;
+    switch (req.op) {
+
+        case CTL_LOAD:
+        init_vm(vm);
+        cpu->quirks = quirks;
+        ld_ram_char(&vm->ram);
+        ld_ram_buf(&vm->ram, body, req.len, &err);
+        break;
+
+        // Replied to by _run_slices once the frames have run
+        case CTL_RUN:
+        cl->frames = req.arg;
+        break;
+
+        case CTL_KEYS:
+        this->keys = req.arg & 0xffff;
+        break;
+
+        case CTL_SAVE:
+        case CTL_RESTORE:
+        if (req.slot >= CTL_SLOTS || (req.op == CTL_RESTORE &&
+                !this->has_slot[req.slot])) {
+            err.code = ERR_RANGE;
+            snprintf(err.msg, MAX_ERR_MSG_LEN, "No snapshot slot %u",
+                req.slot);
+        } else if (req.op == CTL_SAVE) {
+            clone_vm(&this->slots[req.slot], vm);
+            this->has_slot[req.slot] = true;
+        } else {
+            clone_vm(vm, &this->slots[req.slot]);
+        }
+        break;
+
+        case CTL_VID:
+        _reply(cl, req.op, &err, vm->vid.rows, sizeof(vm->vid.rows));
+        return;
+
+        case CTL_RAM:
+        if ((uint32_t) req.addr + req.arg > sizeof(read_vm_ram(vm)->data)) {
+            err.code = ERR_RANGE;
+            snprintf(err.msg, MAX_ERR_MSG_LEN, "RAM range %03x+%x is past "
+                "the end", req.addr, req.arg);
+            break;
+        }
+        _reply(cl, req.op, &err, read_vm_ram(vm)->data + req.addr, req.arg);
+        return;
+
+        case CTL_STATS:
+        this->stats.pc = cpu->pc;
+        this->stats.i_reg = cpu->i_reg;
+        this->stats.instr = cpu->instr;
+        memcpy(this->stats.v_regs, cpu->v_regs, sizeof(cpu->v_regs));
+        this->stats.del_timer = cpu->del_timer;
+        this->stats.snd_timer = cpu->snd_timer;
+        this->stats.sp = cpu->sp;
+        _reply(cl, req.op, &err, &this->stats, sizeof(this->stats));
+        return;
+
+        case CTL_QUIT:
+        this->quit = true;
+        break;
+
+        default:
+        err.code = ERR_DATA;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "Unknown request %u", req.op);
+        break;
+    }
+    if (cl->frames == 0) _reply(cl, req.op, &err, NULL, 0);
+}
+
+// Drop the request at the start of a client's input, keeping any after it.
+static void _consume(CtlClient *cl) {
+    CtlReq      req;
+    uint32_t    len;
+
+    memcpy(&req, cl->in, sizeof(req));
+    len = sizeof(req) + req.len;
+    memmove(cl->in, cl->in + len, cl->in_len - len);
+    cl->in_len -= len;
+}
+
+// Return data indicates if a client's input starts with a whole request.
+static bool _has_req(const CtlClient *cl) {
+    CtlReq req;
+
+    if (cl->in_len < sizeof(req)) return false;
+    memcpy(&req, cl->in, sizeof(req));
+    return cl->in_len >= sizeof(req) + req.len;
+}
+
+static void _close_client(Ctl *this, CtlClient *cl) {
+    epoll_ctl(this->efd, EPOLL_CTL_DEL, cl->fd, NULL);
+    close(cl->fd);
+    cl->fd = -1;
+    this->stats.clients--;
+}
+
+// Handle whatever a client has ready, send what it can of its reply, and
+// set which events to wait for on it. Return data indicates if it is still
+// connected.
+static bool _pump(Ctl *this, CtlClient *cl) {
+    struct epoll_event  ev;
+    CtlReq              req;
+    ssize_t             n;
+
+    while (true) {
+        while (cl->out_off < cl->out_len) {
+            n = write(cl->fd, cl->out + cl->out_off, cl->out_len -
+                cl->out_off);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0) {
+                _close_client(this, cl);
+                return false;
+            }
+            cl->out_off += n;
+        }
+        if (cl->out_off < cl->out_len || cl->frames > 0 || !_has_req(cl)) {
+            break;
+        }
+        _handle(this, cl);
+        _consume(cl);
+    }
+
+    // A request too large for the buffer can never be completed
+    if (cl->in_len >= sizeof(req)) {
+        memcpy(&req, cl->in, sizeof(req));
+        if (req.len > MAX_CTL_BODY) {
+            _close_client(this, cl);
+            return false;
+        }
+    }
+    ev.events = 0;
+    if (cl->in_len < sizeof(cl->in) && !_has_req(cl)) ev.events |= EPOLLIN;
+    if (cl->out_off < cl->out_len) ev.events |= EPOLLOUT;
+    if (ev.events != cl->ev) {
+        ev.data.ptr = cl;
+        epoll_ctl(this->efd, EPOLL_CTL_MOD, cl->fd, &ev);
+        cl->ev = ev.events;
+    }
+    return true;
+}
+
+// Accept every waiting connection, turning away those past the limit.
+static void _accept(Ctl *this) {
+    struct epoll_event  ev;
+    CtlClient           *cl;
+    int                 fd;
+
+    while ((fd = accept(this->lfd, NULL, NULL)) >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        cl = NULL;
+        for (uint32_t i = 0; i < MAX_CTL_CLIENTS && cl == NULL; i++) {
+            if (this->clients[i].fd < 0) cl = &this->clients[i];
+        }
+        if (cl == NULL) {
+            close(fd);
+            continue;
+        }
+        cl->fd = fd;
+        cl->ev = EPOLLIN;
+        cl->in_len = 0;
+        cl->out_len = 0;
+        cl->out_off = 0;
+        cl->frames = 0;
+        ev.events = EPOLLIN;
+        ev.data.ptr = cl;
+        if (epoll_ctl(this->efd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            cl->fd = -1;
+            continue;
+        }
+        this->stats.clients++;
+    }
+}
+
+// Read what a client has sent. Return data indicates if it is still
+// connected.
+static bool _read_client(Ctl *this, CtlClient *cl) {
+    ssize_t n;
+
+    n = read(cl->fd, cl->in + cl->in_len, sizeof(cl->in) - cl->in_len);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        _close_client(this, cl);
+        return false;
+    }
+    if (n > 0) cl->in_len += n;
+    return true;
+}
+
+// Run a slice of the frames each client is waiting on, replying to those
+// that finish.
+static void _run_slices(Ctl *this) {
+    CtlClient   *cl;
+    uint32_t    n;
+    Err         err;
+
+    for (uint32_t i = 0; i < MAX_CTL_CLIENTS; i++) {
+        cl = &this->clients[i];
+        if (cl->fd < 0 || cl->frames == 0) continue;
+        init_err(&err);
+        n = cl->frames < CTL_SLICE ? cl->frames : CTL_SLICE;
+        for (uint32_t j = 0; j < n && !is_err(&err); j++) {
+            this->stats.idle_frames += run_vm_frame(this->vm, this->keys,
+                this->stats.cpf, &err);
+            this->stats.frames++;
+        }
+        cl->frames = is_err(&err) ? 0 : cl->frames - n;
+        if (cl->frames == 0) {
+            _reply(cl, CTL_RUN, &err, NULL, 0);
+            _pump(this, cl);
+        }
+    }
+}
+
+void open_ctl(Ctl *this, const char *path, Vm *vm, uint32_t cpf, Err *err) {
+    struct sockaddr_un  addr;
+    struct epoll_event  ev;
+    struct stat         st;
+
+    memset(&this->stats, 0, sizeof(this->stats));
+    this->stats.cpf = cpf;
+    this->path = path;
+    this->vm = vm;
+    this->keys = 0;
+    this->quit = false;
+    this->efd = -1;
+    for (uint32_t i = 0; i < CTL_SLOTS; i++) {
+        this->has_slot[i] = false;
+    }
+    for (uint32_t i = 0; i < MAX_CTL_CLIENTS; i++) {
+        this->clients[i].fd = -1;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Socket path must be under %zu "
+            "chars", sizeof(addr.sun_path));
+        this->lfd = -1;
+        return;
+    }
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    this->lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+        0);
+    if (this->lfd < 0 || bind(this->lfd, (struct sockaddr *) &addr,
+            sizeof(addr)) != 0 || listen(this->lfd, MAX_CTL_CLIENTS) != 0) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not listen on %s", path);
+        close_ctl(this);
+        return;
+    }
+    this->efd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (this->efd < 0 || epoll_ctl(this->efd, EPOLL_CTL_ADD, this->lfd,
+            &ev) != 0) {
+        err->code = ERR_SUBSYS;
+        strcpy(err->msg, "Could not set up epoll");
+        close_ctl(this);
+    }
+}
+
+void serve_ctl(Ctl *this, Err *err) {
+    struct epoll_event  evs[MAX_CTL_CLIENTS + 1];
+    CtlClient           *cl;
+    bool                busy        = false;
+    int                 n;
+
+    while (!this->quit) {
+
+        // Only block while no frames are waiting to be run
+        n = epoll_wait(this->efd, evs, MAX_CTL_CLIENTS + 1, busy ? 0 : -1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            err->code = ERR_SUBSYS;
+            strcpy(err->msg, "Could not wait for clients");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            cl = evs[i].data.ptr;
+            if (cl == NULL) {
+                _accept(this);
+                continue;
+            }
+            if (cl->fd < 0) continue;
+            if ((evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+                    !_read_client(this, cl)) {
+                continue;
+            }
+            _pump(this, cl);
+        }
+        _run_slices(this);
+        busy = false;
+        for (uint32_t i = 0; i < MAX_CTL_CLIENTS; i++) {
+            busy |= this->clients[i].fd >= 0 && this->clients[i].frames > 0;
+        }
+    }
+
+    // Make a last attempt to send every reply, including the one to quit
+    for (uint32_t i = 0; i < MAX_CTL_CLIENTS; i++) {
+        cl = &this->clients[i];
+        if (cl->fd >= 0 && cl->out_off < cl->out_len) {
+            n = write(cl->fd, cl->out + cl->out_off, cl->out_len -
+                cl->out_off);
+        }
+    }
+}
+
+void close_ctl(Ctl *this) {
+    for (uint32_t i = 0; i < MAX_CTL_CLIENTS; i++) {
+        if (this->clients[i].fd >= 0) _close_client(this, &this->clients[i]);
+    }
+    if (this->efd >= 0) close(this->efd);
+    if (this->lfd >= 0) {
+        close(this->lfd);
+        unlink(this->path);
+    }
+    this->efd = -1;
+    this->lfd = -1;
+}
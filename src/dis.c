@@ -0,0 +1,157 @@
+// Copyright (C) 2024  KA Wright
+
+// dis.c - Instruction decoding and disassembly
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dis.h"
+
+static const char *_cls_names[OP_CLS_LEN] = {
+    [OP_SYS]        = "SYS addr",
+    [OP_CLS]        = "CLS",
+    [OP_RET]        = "RET",
+    [OP_JP]         = "JP addr",
+    [OP_CALL]       = "CALL addr",
+    [OP_SE_BYTE]    = "SE Vx, byte",
+    [OP_SNE_BYTE]   = "SNE Vx, byte",
+    [OP_SE_REG]     = "SE Vx, Vy",
+    [OP_LD_BYTE]    = "LD Vx, byte",
+    [OP_ADD_BYTE]   = "ADD Vx, byte",
+    [OP_LD_REG]     = "LD Vx, Vy",
+    [OP_OR]         = "OR Vx, Vy",
+    [OP_AND]        = "AND Vx, Vy",
+    [OP_XOR]        = "XOR Vx, Vy",
+    [OP_ADD_REG]    = "ADD Vx, Vy",
+    [OP_SUB]        = "SUB Vx, Vy",
+    [OP_SHR]        = "SHR Vx",
+    [OP_SUBN]       = "SUBN Vx, Vy",
+    [OP_SHL]        = "SHL Vx",
+    [OP_SNE_REG]    = "SNE Vx, Vy",
+    [OP_LD_I]       = "LD I, addr",
+    [OP_JP_V0]      = "JP V0, addr",
+    [OP_RND]        = "RND Vx, byte",
+    [OP_DRW]        = "DRW Vx, Vy, n",
+    [OP_SKP]        = "SKP Vx",
+    [OP_SKNP]       = "SKNP Vx",
+    [OP_LD_DT_GET]  = "LD Vx, DT",
+    [OP_LD_K]       = "LD Vx, K",
+    [OP_LD_DT_SET]  = "LD DT, Vx",
+    [OP_LD_ST]      = "LD ST, Vx",
+    [OP_ADD_I]      = "ADD I, Vx",
+    [OP_LD_F]       = "LD F, Vx",
+    [OP_LD_B]       = "LD B, Vx",
+    [OP_LD_MEM_SET] = "LD [I], Vx",
+    [OP_LD_MEM_GET] = "LD Vx, [I]",
+    [OP_ILLEGAL]    = "ILLEGAL",
+};
+
+OpCls get_op_cls(uint16_t instr) {
+    uint8_t n   = instr & 0x000f;
+    uint8_t kk  = instr & 0x00ff;
+
+    switch (instr >> 12) {
+        case 0x0:
+        if (instr == 0x00e0) return OP_CLS;
+        if (instr == 0x00ee) return OP_RET;
+        return OP_SYS;
+
+        case 0x1: return OP_JP;
+        case 0x2: return OP_CALL;
+        case 0x3: return OP_SE_BYTE;
+        case 0x4: return OP_SNE_BYTE;
+        case 0x5: return n == 0 ? OP_SE_REG : OP_ILLEGAL;
+        case 0x6: return OP_LD_BYTE;
+        case 0x7: return OP_ADD_BYTE;
+
+        case 0x8:
+        switch (n) {
+            case 0x0: return OP_LD_REG;
+            case 0x1: return OP_OR;
+            case 0x2: return OP_AND;
+            case 0x3: return OP_XOR;
+            case 0x4: return OP_ADD_REG;
+            case 0x5: return OP_SUB;
+            case 0x6: return OP_SHR;
+            case 0x7: return OP_SUBN;
+            case 0xe: return OP_SHL;
+            default: return OP_ILLEGAL;
+        }
+
+        case 0x9: return n == 0 ? OP_SNE_REG : OP_ILLEGAL;
+        case 0xa: return OP_LD_I;
+        case 0xb: return OP_JP_V0;
+        case 0xc: return OP_RND;
+        case 0xd: return OP_DRW;
+
+        case 0xe:
+        if (kk == 0x9e) return OP_SKP;
+        if (kk == 0xa1) return OP_SKNP;
+        return OP_ILLEGAL;
+
+        default:
+        switch (kk) {
+            case 0x07: return OP_LD_DT_GET;
+            case 0x0a: return OP_LD_K;
+            case 0x15: return OP_LD_DT_SET;
+            case 0x18: return OP_LD_ST;
+            case 0x1e: return OP_ADD_I;
+            case 0x29: return OP_LD_F;
+            case 0x33: return OP_LD_B;
+            case 0x55: return OP_LD_MEM_SET;
+            case 0x65: return OP_LD_MEM_GET;
+            default: return OP_ILLEGAL;
+        }
+    }
+}
+
+const char *get_op_cls_name(OpCls cls) {
+    return cls < OP_CLS_LEN ? _cls_names[cls] : "?";
+}
+
+void dis_op(uint16_t instr, char *out) {
+    uint8_t     x   = (instr & 0x0f00) >> 8;
+    uint8_t     y   = (instr & 0x00f0) >> 4;
+    uint8_t     n   = instr & 0x000f;
+    uint8_t     kk  = instr & 0x00ff;
+    uint16_t    nnn = instr & 0x0fff;
+
+    switch (get_op_cls(instr)) {
+        case OP_SYS:        sprintf(out, "SYS %03x", nnn); break;
+        case OP_CLS:        sprintf(out, "CLS"); break;
+        case OP_RET:        sprintf(out, "RET"); break;
+        case OP_JP:         sprintf(out, "JP %03x", nnn); break;
+        case OP_CALL:       sprintf(out, "CALL %03x", nnn); break;
+        case OP_SE_BYTE:    sprintf(out, "SE V%X, %02x", x, kk); break;
+        case OP_SNE_BYTE:   sprintf(out, "SNE V%X, %02x", x, kk); break;
+        case OP_SE_REG:     sprintf(out, "SE V%X, V%X", x, y); break;
+        case OP_LD_BYTE:    sprintf(out, "LD V%X, %02x", x, kk); break;
+        case OP_ADD_BYTE:   sprintf(out, "ADD V%X, %02x", x, kk); break;
+        case OP_LD_REG:     sprintf(out, "LD V%X, V%X", x, y); break;
+        case OP_OR:         sprintf(out, "OR V%X, V%X", x, y); break;
+        case OP_AND:        sprintf(out, "AND V%X, V%X", x, y); break;
+        case OP_XOR:        sprintf(out, "XOR V%X, V%X", x, y); break;
+        case OP_ADD_REG:    sprintf(out, "ADD V%X, V%X", x, y); break;
+        case OP_SUB:        sprintf(out, "SUB V%X, V%X", x, y); break;
+        case OP_SHR:        sprintf(out, "SHR V%X", x); break;
+        case OP_SUBN:       sprintf(out, "SUBN V%X, V%X", x, y); break;
+        case OP_SHL:        sprintf(out, "SHL V%X", x); break;
+        case OP_SNE_REG:    sprintf(out, "SNE V%X, V%X", x, y); break;
+        case OP_LD_I:       sprintf(out, "LD I, %03x", nnn); break;
+        case OP_JP_V0:      sprintf(out, "JP V0, %03x", nnn); break;
+        case OP_RND:        sprintf(out, "RND V%X, %02x", x, kk); break;
+        case OP_DRW:        sprintf(out, "DRW V%X, V%X, %x", x, y, n); break;
+        case OP_SKP:        sprintf(out, "SKP V%X", x); break;
+        case OP_SKNP:       sprintf(out, "SKNP V%X", x); break;
+        case OP_LD_DT_GET:  sprintf(out, "LD V%X, DT", x); break;
+        case OP_LD_K:       sprintf(out, "LD V%X, K", x); break;
+        case OP_LD_DT_SET:  sprintf(out, "LD DT, V%X", x); break;
+        case OP_LD_ST:      sprintf(out, "LD ST, V%X", x); break;
+        case OP_ADD_I:      sprintf(out, "ADD I, V%X", x); break;
+        case OP_LD_F:       sprintf(out, "LD F, V%X", x); break;
+        case OP_LD_B:       sprintf(out, "LD B, V%X", x); break;
+        case OP_LD_MEM_SET: sprintf(out, "LD [I], V%X", x); break;
+        case OP_LD_MEM_GET: sprintf(out, "LD V%X, [I]", x); break;
+        default:            sprintf(out, "DW %04x", instr); break;
+    }
+}
@@ -0,0 +1,138 @@
+// Copyright (C) 2024  KA Wright
+
+// dump.c - RAM dumps
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dump.h"
+#include "err.h"
+#include "ram.h"
+
+#define RAM_SZ                  (ADDR_PROG_END + 1)
+#define DIFF_LINE_LEN           18      // "@addr    old -> new\n"
+#define DIFF_HDR_LEN            64
+#define MAX_DUMP_SZ             (DIFF_HDR_LEN + RAM_SZ * DIFF_LINE_LEN)
+
+static const char _hex[] = "0123456789abcdef";
+
+// Format the low n nibbles of val as hex. Return data is the end of out.
+static inline char *_put_hex(char *out, uint16_t val, uint8_t n) {
+    for (int8_t i = n - 1; i >= 0; i--) {
+        *out++ = _hex[(val >> (i * 4)) & 0xf];
+    }
+    return out;
+}
+
+static size_t _fmt_hex(char *buf, const uint8_t *data) {
+    char *out = buf;
+
+    for (uint16_t i = 0; i < RAM_SZ; i += HEX_DUMP_ROW) {
+        *out++ = '@';
+        out = _put_hex(out, i, 3);
+        memset(out, ' ', 4);
+        out += 4;
+        for (uint16_t j = i; j < i + HEX_DUMP_ROW; j++) {
+            out = _put_hex(out, data[j], 2);
+            *out++ = ' ';
+        }
+        *out++ = '\n';
+    }
+    return out - buf;
+}
+
+static size_t _fmt_diff(char *buf, const uint8_t *prev, const uint8_t *data,
+        uint32_t seq) {
+    char        *out        = buf;
+    uint16_t    n           = 0;
+
+    for (uint16_t i = 0; i < RAM_SZ; i++) {
+        n += prev[i] != data[i];
+    }
+    if (seq == 0) {
+        out += sprintf(out, "# %u bytes changed since ROM load\n", n);
+    } else {
+        out += sprintf(out, "# %u bytes changed since dump %u\n", n,
+            seq - 1);
+    }
+    for (uint16_t i = 0; i < RAM_SZ; i++) {
+        if (prev[i] == data[i]) continue;
+        *out++ = '@';
+        out = _put_hex(out, i, 3);
+        memset(out, ' ', 4);
+        out += 4;
+        out = _put_hex(out, prev[i], 2);
+        memcpy(out, " -> ", 4);
+        out += 4;
+        out = _put_hex(out, data[i], 2);
+        *out++ = '\n';
+    }
+    return out - buf;
+}
+
+void init_dump(Dump *this, DumpFmt fmt, const Ram *ram) {
+    this->fmt = fmt;
+    this->seq = 0;
+    memcpy(this->prev, ram->data, RAM_SZ);
+}
+
+bool get_dump_fmt(const char *name, DumpFmt *fmt) {
+    if (strcmp(name, "hex") == 0) {
+        *fmt = DUMP_HEX;
+    } else if (strcmp(name, "bin") == 0) {
+        *fmt = DUMP_BIN;
+    } else if (strcmp(name, "diff") == 0) {
+        *fmt = DUMP_DIFF;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void sv_dump(Dump *this, const Ram *ram, Err *err) {
+    static char buf[MAX_DUMP_SZ];
+    const void  *out        = buf;
+    size_t      len;
+    char        fname[48];
+    int         fd;
+
+    switch (this->fmt) {
+
+        case DUMP_BIN:
+        out = ram->data;
+        len = RAM_SZ;
+        break;
+
+        case DUMP_DIFF:
+        len = _fmt_diff(buf, this->prev, ram->data, this->seq);
+        break;
+
+        default:
+        len = _fmt_hex(buf, ram->data);
+        break;
+    }
+
+    // Number dumps so several taken within a second do not collide
+    snprintf(fname, sizeof(fname), "k8e_ram_dump_%lu_%u.%s",
+        (unsigned long) time(NULL), this->seq, this->fmt == DUMP_BIN ?
+        "bin" : "txt");
+    fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    if (write(fd, out, len) != (ssize_t) len) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not write file %s", fname);
+    }
+    close(fd);
+    memcpy(this->prev, ram->data, RAM_SZ);
+    this->seq++;
+}
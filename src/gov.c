@@ -0,0 +1,84 @@
+// Copyright (C) 2024  KA Wright
+
+// gov.c - Adaptive instructions-per-frame governor
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gov.h"
+#include "turbo.h"
+
+void init_gov(Gov *this, Turbo *turbo) {
+    this->base_cpf      = turbo->cpf > 0 ? turbo->cpf : 1;
+    this->max_cpf       = this->base_cpf * GOV_MAX_SCALE;
+    this->work          = 0;
+    this->last_draw     = 0;
+    this->since_wait    = GOV_PACED_FRAMES;
+    this->waited        = false;
+    this->act           = GOV_HOLD;
+    this->stats         = (GovStats) {0};
+    turbo->cpf          = this->base_cpf;
+}
+
+// Move the budget of turbo to cpf, noting which way it went.
+static void _set_cpf(Gov *this, Turbo *turbo, uint32_t cpf) {
+    if (cpf > this->max_cpf) cpf = this->max_cpf;
+    if (cpf < 1) cpf = 1;
+    if (cpf > turbo->cpf) {
+        this->act = GOV_RAISE;
+        this->stats.raises++;
+    } else if (cpf < turbo->cpf) {
+        this->act = GOV_CUT;
+        this->stats.cuts++;
+    } else {
+        this->act = GOV_HOLD;
+    }
+    turbo->cpf = cpf;
+}
+
+void end_gov_frame(Gov *this, Turbo *turbo) {
+    uint32_t target;
+
+    this->stats.frames++;
+    this->stats.budget += turbo->cpf;
+    this->stats.work += this->waited ? this->work : this->last_draw;
+    if (this->waited) {
+        this->stats.idle_frames++;
+        this->since_wait = 0;
+
+        // Keep a quarter over the work, and give it back slowly so a frame
+        // that waited early does not starve the next
+        target = this->work + this->work / 4 + 2;
+        if (target < turbo->cpf) {
+            target = turbo->cpf - (turbo->cpf - target + GOV_CUT_RATE - 1) /
+                GOV_CUT_RATE;
+        }
+        _set_cpf(this, turbo, target);
+    } else if (this->since_wait < GOV_PACED_FRAMES) {
+
+        // A paced ROM that ran out of budget is short of headroom
+        this->stats.busy_frames++;
+        this->since_wait++;
+        _set_cpf(this, turbo, turbo->cpf + turbo->cpf / 2 + 1);
+    } else {
+        _set_cpf(this, turbo, this->base_cpf);
+    }
+    this->work = 0;
+    this->last_draw = 0;
+    this->waited = false;
+}
+
+void print_gov_stats(const Gov *this) {
+    const GovStats *stats = &this->stats;
+
+    if (stats->frames == 0) return;
+    printf("Governor: %" PRIu64 " frames, %" PRIu64 " idle, %" PRIu64
+        " busy, %" PRIu64 " draws\n", stats->frames, stats->idle_frames,
+        stats->busy_frames, stats->draws);
+    printf("Governor: %" PRIu64 " budget/frame (nominal %u), %" PRIu64
+        " work/frame, %u raises, %u cuts\n", stats->budget / stats->frames,
+        this->base_cpf, stats->work / stats->frames, stats->raises,
+        stats->cuts);
+}
@@ -4,9 +4,13 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "err.h"
 #include "graphic.h"
+#include "perf.h"
+#include "ram.h"
+#include "vid.h"
 
 void init_win(Win *this, uint32_t bg, uint32_t fg, uint8_t px_sz) {
     this->sdl_win           = NULL;
@@ -14,11 +18,6 @@ void init_win(Win *this, uint32_t bg, uint32_t fg, uint8_t px_sz) {
     this->bg                = bg;
     this->fg                = fg;
     this->px_sz             = px_sz;
-    for (uint8_t y = 0; y < 32; y++) {
-        for (uint8_t x = 0; x < 64; x++) {
-            this->px_map[x][y] = false;
-        } 
-    }
 }
 
 void open_win(Win *this, Err *err) {
@@ -34,11 +33,6 @@ void open_win(Win *this, Err *err) {
 }
 
 void clear_win(Win *this, Err *err) {
-    for (uint8_t y = 0; y < 32; y++) {
-        for (uint8_t x = 0; x < 64; x++) {
-            this->px_map[x][y] = false;
-        }
-    }
     uint8_t     r           = (this->bg & 0xff0000) >> 16;
     uint8_t     g           = (this->bg & 0x00ff00) >> 8;
     uint8_t     b           = (this->bg & 0x0000ff);
@@ -55,40 +49,99 @@ void close_win(Win *this) {
     SDL_DestroyWindow(this->sdl_win);
 }
 
-bool draw_px(Win *win, uint8_t x, uint8_t y, Err *err) {
+void draw_px(Win *win, uint8_t x, uint8_t y, Err *err) {
     uint16_t    real_x      = win->px_sz * x;
     uint16_t    real_y      = win->px_sz * y;
     SDL_Rect    px_rect     = {real_x, real_y, win->px_sz, win->px_sz};
+    uint8_t     r           = (win->fg & 0xff0000) >> 16;
+    uint8_t     g           = (win->fg & 0x00ff00) >> 8;
+    uint8_t     b           = (win->fg & 0x0000ff);
     int         results;
-    bool        ret         = false;
-    uint8_t     r;
-    uint8_t     g;
-    uint8_t     b;
-    
-
-    if (win->px_map[x][y]) {
-        ret     = true;
-        r       = (win->bg & 0xff0000) >> 16;
-        g       = (win->bg & 0x00ff00) >> 8;
-        b       = (win->bg & 0x0000ff);
-        results = SDL_FillRect(win->sdl_surf, &px_rect, 
-            SDL_MapRGB(win->sdl_surf->format, r, g, b));
-        win->px_map[x][y] = false;
-    } else {
-        r       = (win->fg & 0xff0000) >> 16;
-        g       = (win->fg & 0x00ff00) >> 8;
-        b       = (win->fg & 0x0000ff);
-        results = SDL_FillRect(win->sdl_surf, &px_rect, 
-            SDL_MapRGB(win->sdl_surf->format, r, g, b));
-        win->px_map[x][y] = true;
-        
-    }
+
+    results = SDL_FillRect(win->sdl_surf, &px_rect, 
+        SDL_MapRGB(win->sdl_surf->format, r, g, b));
     if (results != 0) {
         err->code = ERR_SUBSYS;
         strcpy(err->msg, "Could not perform draw operation");
-        return ret;
     }
-    return ret;
+}
+
+void paint_win(Win *this, const Vid *vid, Err *err) {
+    clear_win(this, err);
+    if (is_err(err)) return;
+    for (uint8_t y = 0; y < VID_H; y++) {
+        if (vid->rows[y] == 0) continue;
+        for (uint8_t x = 0; x < VID_W; x++) {
+            if (read_vid(vid, x, y)) {
+                draw_px(this, x, y, err);
+                if (is_err(err)) return;
+            }
+        }
+    }
+}
+
+void draw_win(Win *this, const Vid *vid, Err *err) {
+    paint_win(this, vid, err);
+    if (is_err(err)) return;
+    redraw_win(this);
+}
+
+// Fill a rectangle of a Win with an 0xrrggbb color.
+static void _fill_win(Win *this, uint16_t x, uint16_t y, uint16_t w,
+        uint16_t h, uint32_t rgb, Err *err) {
+    SDL_Rect rect = {x, y, w, h};
+
+    if (SDL_FillRect(this->sdl_surf, &rect, SDL_MapRGB(this->sdl_surf->format,
+            rgb >> 16, (rgb >> 8) & 0xff, rgb & 0xff)) != 0) {
+        err->code = ERR_SUBSYS;
+        strcpy(err->msg, "Could not perform draw operation");
+    }
+}
+
+// Draw n in decimal at (x, y) in the fg color, with the hex digit sprites
+// at u pixels to a sprite pixel.
+static void _draw_num_win(Win *this, uint16_t x, uint16_t y, uint64_t n,
+        uint8_t u, Err *err) {
+    const uint8_t   *font       = get_ram_font();
+    char            buf[21];
+    const uint8_t   *spr;
+
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long) n);
+    for (uint8_t i = 0; buf[i] != '\0' && !is_err(err); i++) {
+        spr = font + (buf[i] - '0') * 5;
+        for (uint8_t row = 0; row < 5; row++) {
+            for (uint8_t col = 0; col < 4; col++) {
+                if (!(spr[row] & (0x80 >> col))) continue;
+                _fill_win(this, x + (i * 5 + col) * u, y + row * u, u, u,
+                    this->fg, err);
+            }
+        }
+    }
+}
+
+void draw_perf_win(Win *this, const PerfStats *stats, Err *err) {
+    static const uint32_t colors[PERF_SYS_LEN] = {
+        0xff4040, 0x40ff40, 0x4080ff, 0xffff40, 0x808080
+    };
+    uint8_t     u           = this->px_sz / 4 > 0 ? this->px_sz / 4 : 1;
+    uint16_t    y           = 2 * u;
+    uint64_t    nums[3];
+    uint64_t    wall        = stats->wall_ns > 0 ? stats->wall_ns : 1;
+
+    nums[0] = stats->ops * 1000000000 / wall;
+    nums[1] = stats->presented;
+    nums[2] = stats->dropped;
+    _fill_win(this, u, u, 66 * u, (PERF_SYS_LEN * 3 + 3 * 7 + 1) * u,
+        this->bg, err);
+    for (uint8_t i = 0; i < PERF_SYS_LEN && !is_err(err); i++) {
+        _fill_win(this, 2 * u, y, (stats->ns[i] * 64 / wall) * u, 2 * u,
+            colors[i], err);
+        y += 3 * u;
+    }
+    for (uint8_t i = 0; i < 3 && !is_err(err); i++) {
+        _draw_num_win(this, 2 * u, y + u, nums[i], u, err);
+        y += 7 * u;
+    }
 }
 
 void redraw_win(Win *this) {
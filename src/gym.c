@@ -0,0 +1,79 @@
+// Copyright (C) 2024  KA Wright
+
+// gym.c - Frame stepping and rewards for learning agents
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "err.h"
+#include "gym.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+void init_gym(Gym *this, uint32_t cpf) {
+    this->cpf = cpf;
+    this->len = 0;
+}
+
+bool add_gym_term(Gym *this, uint16_t addr, uint8_t len, bool bcd,
+        int32_t scale) {
+    GymTerm *term;
+
+    if (this->len >= MAX_GYM_TERMS || len == 0 || len > (bcd ? 9 : 4)) {
+        return false;
+    }
+    term = &this->terms[this->len++];
+    term->addr = addr & ADDR_PROG_END;
+    term->len = len;
+    term->bcd = bcd;
+    term->scale = scale;
+    return true;
+}
+
+int64_t read_gym_score(const Gym *this, const Vm *vm) {
+    const uint8_t   *data       = read_vm_ram(vm)->data;
+    const GymTerm   *term;
+    int64_t         score       = 0;
+    int64_t         val;
+
+    for (uint8_t i = 0; i < this->len; i++) {
+        term = &this->terms[i];
+        val = 0;
+        for (uint8_t j = 0; j < term->len; j++) {
+            val = val * (term->bcd ? 10 : 256) + data[(term->addr + j) &
+                ADDR_PROG_END];
+        }
+        score += val * term->scale;
+    }
+    return score;
+}
+
+int64_t step_vm(Vm *this, const Gym *gym, uint16_t keys, uint32_t frames,
+        uint64_t *obs, Err *err) {
+    int64_t score = read_gym_score(gym, this);
+
+    for (uint32_t i = 0; i < frames && !is_err(err); i++) {
+        run_vm_frame(this, keys, gym->cpf, err);
+    }
+    if (obs != NULL) memcpy(obs, this->vid.rows, sizeof(this->vid.rows));
+    return read_gym_score(gym, this) - score;
+}
+
+void step_vms(Vm *this, uint32_t len, const Gym *gym, const uint16_t *keys,
+        uint32_t frames, uint64_t *obs, int64_t *rews, Err *err) {
+    int64_t rew;
+
+    for (uint32_t i = 0; i < len; i++) {
+        rew = step_vm(&this[i], gym, keys[i], frames, obs != NULL ?
+            obs + (size_t) i * GYM_OBS_WORDS : NULL, err);
+        if (rews != NULL) rews[i] = rew;
+        if (is_err(err)) {
+            snprintf(err->msg + strlen(err->msg), MAX_ERR_MSG_LEN -
+                strlen(err->msg), " (machine %u)", i);
+            return;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2024  KA Wright
+
+// hash.c - State hashing
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "hash.h"
+#include "vid.h"
+
+#define FNV_PRIME               0x100000001b3
+
+uint64_t hash_bytes(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t hash_vid(const Vid *vid) {
+    uint8_t buf[VID_H * VID_W / 8];
+
+    // Rows are stored as words, so serialize them leftmost pixel first
+    for (uint8_t y = 0; y < VID_H; y++) {
+        for (uint8_t i = 0; i < VID_W / 8; i++) {
+            buf[y * (VID_W / 8) + i] = vid->rows[y] >> (VID_W - 8 - i * 8);
+        }
+    }
+    return hash_bytes(HASH_SEED, buf, sizeof(buf));
+}
+
+uint64_t hash_cpu(const Cpu *cpu) {
+    uint8_t buf[16 + 2 + 1 + 1 + 2 + 1 + 16 * 2];
+    uint8_t *p = buf;
+
+    for (uint8_t i = 0; i < 16; i++) {
+        *p++ = cpu->v_regs[i];
+    }
+    *p++ = cpu->i_reg >> 8;
+    *p++ = cpu->i_reg;
+    *p++ = cpu->del_timer;
+    *p++ = cpu->snd_timer;
+    *p++ = cpu->pc >> 8;
+    *p++ = cpu->pc;
+    *p++ = cpu->sp;
+    for (uint8_t i = 0; i < 16; i++) {
+        *p++ = cpu->stk[i] >> 8;
+        *p++ = cpu->stk[i];
+    }
+    return hash_bytes(HASH_SEED, buf, sizeof(buf));
+}
@@ -7,79 +7,102 @@
 #include <stdint.h>
 #include <time.h>
 
+#include "brk.h"
 #include "clean.h"
 #include "clock.h"
 #include "cpu.h"
+#include "dump.h"
 #include "err.h"
 #include "idle.h"
+#include "jrnl.h"
 #include "key.h"
+#include "perf.h"
 #include "ram.h"
 #include "savest.h"
+#include "turbo.h"
+#include "vid.h"
+#include "vm.h"
 
-void do_idle_loop(Clk *clk, KeySt *key_st, Cpu *cpu, Ram *ram, Win *win, 
-        Err *err) {
-    
-    bool    d_press             = false;
-    bool    x_press             = false;
-    bool    r_press             = false;
-    bool    s_press             = false;
-    bool    t_press             = false;
-    char    sv_st_fname[31]; 
-    SvSt    sv_st;
+// Undo instructions until one stops at a breakpoint or undoes a watched
+// write, or the journal runs out.
+static void _rev_continue(Vm *vm, Jrnl *jrnl, const Brk *brk) {
+    const JrnlEnt *ent;
+
+    while ((ent = undo_jrnl(jrnl, vm)) != NULL) {
+        if (is_brk(brk, vm->cpu.pc)) break;
+        if (ent->kind == JRNL_RAM && is_watched(brk, ent->addr, ent->len)) {
+            break;
+        }
+    }
+}
+
+void do_idle_loop(Clk *clk, KeySt *key_st, Vm *vm, Jrnl *jrnl, 
+        const Brk *brk, Dump *dump, Turbo *turbo, Perf *perf, Err *err) {
     
-    init_sv_st(&sv_st);
+    Cpu         *cpu            = &vm->cpu;
+    char        sv_st_fname[31]; 
+    SvSt        sv_st;
+    uint64_t    start;
 
-    while (!update_clk(clk)) {
+    // Keys are read at least once, so uncapped runs still see input
+    do {
+        start = read_perf_ns();
         update_key_st(key_st);
+        add_perf(perf, PERF_INPUT, start);
 
         if (read_key(key_st, 'q')) {
             err->code = ERR_QUIT;
             return; 
         }
 
-        if (read_key(key_st, 'x')) {
-            if (x_press) continue;
-            x_press = true;
+        if (read_key_press(key_st, 'x')) {
             cpu->paused = true;
-        } else {
-            x_press = false;
         }
 
-        if (read_key(key_st, 'r')) {
-            if (r_press) continue;
-            r_press = true;
+        if (read_key_press(key_st, 'r')) {
             cpu->paused = false;
-        } else {
-            r_press = false;
         }
 
-        if (read_key(key_st, 's')) {
-            if (s_press) continue;
-            s_press = true;
+        if (read_key_press(key_st, 's')) {
             cpu->step = true;
-        } else {
-            s_press = false;
         }
 
-        if (read_key(key_st, 'd')) {
-            if (d_press) continue;
-            d_press = true;
-            dump_ram(ram, err);
+        if (read_key_press(key_st, 'f')) {
+            toggle_turbo(turbo);
+        }
+
+        // Repaint, to show or clear the overlay
+        if (read_key_press(key_st, 'g')) {
+            perf->shown = !perf->shown;
+            vm->vid.dirty = true;
+        }
+
+        if (jrnl != NULL && read_key_press(key_st, 'b')) {
+            cpu->paused = true;
+            undo_jrnl(jrnl, vm);
+        }
+
+        if (jrnl != NULL && read_key_press(key_st, 'v')) {
+            cpu->paused = true;
+            _rev_continue(vm, jrnl, brk);
+        }
+
+        if (read_key_press(key_st, 'd')) {
+            sv_dump(dump, read_vm_ram(vm), err);
             if (is_err(err)) return;
-        } else {
-            d_press = false;
         }
 
-        if (read_key(key_st, 't')) {
-            if (t_press) continue;
-            t_press = true;
-            dump_sv_st(&sv_st, cpu, win, ram);
+        if (read_key_press(key_st, 't')) {
+            own_vm_ram(vm);
+            init_sv_st(&sv_st);
+            dump_sv_st(&sv_st, cpu, &vm->vid, &vm->ram);
             sprintf(sv_st_fname, "savestate_%lu.k8e", 
                 (unsigned long) time(NULL));
             sv_sv_st(&sv_st, sv_st_fname, err);
             if (is_err(err)) return;
-        } else {
-            t_press = false;
         }
-    }   
+
+        // Framed runs only come here between frames, so sleep out the rest
+        if (is_turbo_framed(turbo)) nap_clk(clk);
+    } while (!update_clk(clk));
 }
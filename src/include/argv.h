@@ -8,26 +8,75 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "brk.h"
+#include "cpu.h"
+#include "dump.h"
 #include "err.h"
+#include "romdb.h"
 
 #define ARGV_OPTSTR             "ab:B:c:F:dhl:mpP:t:"
-#define ARGV_MAX_BRKPTS         16
+
+// Flags for the options given, which a ROM database entry must not override
+#define ARGV_GIVEN_FREQ         ROM_HAS_FREQ
+#define ARGV_GIVEN_QUIRKS       ROM_HAS_QUIRKS
+#define ARGV_GIVEN_KEYMAP       ROM_HAS_KEYMAP
+#define ARGV_GIVEN_BG           ROM_HAS_BG
+#define ARGV_GIVEN_FG           ROM_HAS_FG
+
+// Lists options which only have a long form, numbered past any short option.
+typedef enum __ARGV_LONG__ {
+    ARGV_PROFILE = 0x100,
+    ARGV_WATCH,
+    ARGV_RWATCH,
+    ARGV_AWATCH,
+    ARGV_TRACE,
+    ARGV_REWIND,
+    ARGV_SESSION,
+    ARGV_DUMP,
+    ARGV_SPEED,
+    ARGV_QUIRKS,
+    ARGV_KEYMAP,
+    ARGV_ROMDB,
+    ARGV_ADAPTIVE,
+    ARGV_VIP_TIMING,
+    ARGV_RECORD,
+    ARGV_SHM,
+    ARGV_CONTROL,
+    ARGV_BENCH_STARTUP,
+    ARGV_PERF
+} ArgvLong;
 
 // Stores parsed command-line args as fields.
 typedef struct __ARGV__ {
     bool        about;
-    uint16_t    brkpts[16];
-    uint8_t     brkpts_len;
+    bool        adaptive;
+    bool        bench_startup;
+    Brk         brk;
     uint32_t    bg;
     uint32_t    fg;
     uint16_t    clk_freq;
+    char        *control;
     bool        debug;
+    DumpFmt     dump_fmt;
+    uint8_t     given;
     bool        help;
+    const char  *keymap;
     char        *svst;
     bool        mute;
     bool        paused;
+    char        *perf;
+    bool        profile;
     uint16_t    pitch;
+    QuirkProf   quirks;
+    char        *trace;
     uint8_t     px_sz;
+    char        *record;
+    bool        rewind;
+    char        *shm;
+    char        *romdb;
+    uint8_t     speed;
+    bool        vip_timing;
+    char        *sess;
     char        *fname;
 } Argv;
 
@@ -37,4 +86,7 @@ void init_argv(Argv *this);
 // Parse an arg vector.
 void parse_argv(Argv *this, uint16_t argc, char *argv[], Err *err);
 
+// Take the settings of a ROM database entry for any option not given.
+void apply_argv_rom(Argv *this, const RomEnt *ent);
+
 #endif
@@ -6,7 +6,7 @@
 #define __ASSET_H__
 
 #define MAX_ASSET_ABOUT_SZ      255
-#define MAX_ASSET_HELP_SZ       1027
+#define MAX_ASSET_HELP_SZ       4095
 
 // Load the contents of the about file into the out param.
 void ld_asset_about(char *out);
@@ -0,0 +1,58 @@
+// Copyright (C) 2024  KA Wright
+
+// brk.h - Breakpoints and watchpoints
+
+#ifndef __BRK_H__
+#define __BRK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "ram.h"
+
+#define BRK_MAP_LEN             ((ADDR_PROG_END + 1) / 64)
+#define BRK_NO_ADDR             0xffff
+
+// Lists the reasons a Brk can stop execution.
+typedef enum __BRKHIT__ {
+    BRK_HIT_NONE,
+    BRK_HIT_EXEC,
+    BRK_HIT_READ,
+    BRK_HIT_WRITE
+} BrkHit;
+
+// Stores execution breakpoints and RAM watchpoints as one bit per address.
+// Watchpoints are tested against the RAM an instruction will touch (fx33,
+// fx55, fx65 and DRW) before it runs.
+typedef struct __BRK__ {
+    uint64_t    exec[BRK_MAP_LEN];
+    uint64_t    rd[BRK_MAP_LEN];
+    uint64_t    wr[BRK_MAP_LEN];
+    bool        active;
+    uint16_t    held;
+    uint16_t    hit_addr;
+} Brk;
+
+// Initialize a Brk with nothing set.
+void init_brk(Brk *this);
+
+// Set an execution breakpoint at addr.
+void set_brk(Brk *this, uint16_t addr);
+
+// Watch the RAM range lo-hi (inclusive) for reads, writes or both.
+void set_watch(Brk *this, uint16_t lo, uint16_t hi, bool rd, bool wr);
+
+// Test if an execution breakpoint is set at addr.
+bool is_brk(const Brk *this, uint16_t addr);
+
+// Test if any of the len bytes from addr are watched for writes.
+bool is_watched(const Brk *this, uint16_t addr, uint16_t len);
+
+// Test if execution should stop before the next instruction of cpu. A stop
+// is only reported once; after execution resumes, the instruction at that pc
+// runs before it can stop again. On a watchpoint hit, hit_addr holds the
+// first watched address.
+BrkHit check_brk(Brk *this, const Cpu *cpu, const Ram *ram);
+
+#endif
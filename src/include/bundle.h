@@ -0,0 +1,61 @@
+// Copyright (C) 2024  KA Wright
+
+// bundle.h - Indexed multi-ROM bundle files
+
+#ifndef __BUNDLE_H__
+#define __BUNDLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+
+#define BUNDLE_MAGIC            "K8EB"
+#define BUNDLE_VER              1
+#define MAX_BUNDLE_NAME_LEN     48
+
+// Stores the header at the start of a bundle file. The entry table follows
+// it, sorted by name, then the concatenated ROMs. Fields are in host byte
+// order.
+typedef struct __BUNDLE_HDR__ {
+    char        magic[4];
+    uint16_t    ver;
+    uint16_t    ent_sz;
+    uint32_t    len;
+    uint32_t    pad;
+} BundleHdr;
+
+// Stores one entry of a bundle table. The offset is from the start of the
+// file and the hash is FNV-1a 64 over the ROM bytes.
+typedef struct __BUNDLE_ENT__ {
+    char        name[MAX_BUNDLE_NAME_LEN];
+    uint32_t    off;
+    uint32_t    len;
+    uint64_t    hash;
+} BundleEnt;
+
+// Stores an open bundle, mapped read-only and shared, so forked workers all
+// read the same pages.
+typedef struct __BUNDLE__ {
+    const uint8_t   *map;
+    size_t          map_sz;
+    const BundleEnt *ents;
+    uint32_t        len;
+} Bundle;
+
+// Map a bundle file and validate its table: entries must be sorted by name,
+// with their ROMs past the table and within the file. Anything else is
+// ERR_DATA.
+void open_bundle(Bundle *this, const char *fname, Err *err);
+
+// Unmap a bundle.
+void close_bundle(Bundle *this);
+
+// Find the entry named name. Return data is its index, or -1 if absent.
+int64_t find_bundle(const Bundle *this, const char *name);
+
+// Copy ROM idx of a bundle into a Ram straight from the mapping.
+void ld_ram_bundle(Ram *this, const Bundle *bundle, uint32_t idx, Err *err);
+
+#endif
@@ -0,0 +1,52 @@
+// Copyright (C) 2024  KA Wright
+
+// cap.h - Framebuffer video capture
+
+#ifndef __CAP_H__
+#define __CAP_H__
+
+#include <stdint.h>
+
+#include "err.h"
+#include "ring.h"
+#include "vid.h"
+
+#define CAP_RING_SZ             (1 << 18)   // About 17 s of frames
+#define MAX_CAP_SCALE           32
+
+// Lists capture formats, chosen by file extension: a YUV4MPEG2 stream, or a
+// sequence of binary PGM or PBM images.
+typedef enum __CAP_FMT__ {
+    CAP_Y4M,
+    CAP_PGM,
+    CAP_PBM
+} CapFmt;
+
+// Stores an open capture. Frames are queued as the 1 bpp framebuffer and
+// scaled as the writer thread encodes them, so recording a frame is a 256
+// byte copy. A frame that finds the queue full is dropped, not waited on.
+typedef struct __CAP__ {
+    Ring            ring;
+    CapFmt          fmt;
+    uint8_t         scale;
+    uint64_t        frames;
+    uint32_t        dropped;
+    unsigned char   line[VID_W * MAX_CAP_SCALE];
+} Cap;
+
+// Create a capture file, in the format named by the extension of fname
+// (.y4m, .pgm or .pbm), of frames scaled up scale times.
+void open_cap(Cap *this, const char *fname, uint8_t scale, Err *err);
+
+// Queue the current picture of vid as the next frame.
+static inline void rec_cap(Cap *this, const Vid *vid) {
+    if (!offer_ring(&this->ring, vid->rows, sizeof(vid->rows))) {
+        this->dropped++;
+    }
+}
+
+// Encode every queued frame and close a capture. Dropped frames are reported
+// as an error.
+void close_cap(Cap *this, Err *err);
+
+#endif
@@ -0,0 +1,75 @@
+// Copyright (C) 2024  KA Wright
+
+// cfg.h - Static control-flow graph of a ROM
+
+#ifndef __CFG_H__
+#define __CFG_H__
+
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+
+#define CFG_MAGIC               "K8EA"
+#define CFG_VER                 1
+#define CFG_NO_SUCC             0xffff
+#define MAX_CFG_BLKS            (ADDR_PROG_END + 1)
+
+// Lists the facts found about each RAM address. An address may hold both
+// code and data, and code may start at odd addresses.
+typedef enum __CFG_FLAG__ {
+    CFG_CODE        = 1 << 0,   // An instruction starts here
+    CFG_LEADER      = 1 << 1,   // A basic block starts here
+    CFG_CALLED      = 1 << 2,   // A subroutine starts here
+    CFG_DATA        = 1 << 3,   // Read by DRW or fx65 through a known I
+    CFG_WRITTEN     = 1 << 4,   // Written by fx33 or fx55 through a known I
+    CFG_COMPUTED    = 1 << 5,   // A bnnn jump, whose target is not static
+    CFG_WR_ANY      = 1 << 6    // A write through an I that is not static
+} CfgFlag;
+
+// Stores one basic block, from start up to but not including end. A block
+// ends at a jump, call, return, skip or bnnn, or just before another block.
+// Succs are the static successors; a call's are its target and the return
+// site, and a skip's are the next two instructions.
+typedef struct __CFG_BLK__ {
+    uint16_t    start;
+    uint16_t    end;
+    uint16_t    succ[2];
+} CfgBlk;
+
+// Stores the result of analyzing a ROM, with the hash of the program it was
+// built from so that a saved analysis can be matched to its ROM. The I
+// register is tracked along the first path found to each instruction, so
+// data and write facts are a lower bound; self-modifying code is any address
+// with both CFG_CODE and CFG_WRITTEN, or any write marked CFG_WR_ANY.
+typedef struct __CFG__ {
+    uint64_t    hash;
+    uint8_t     flags[ADDR_PROG_END + 1];
+    CfgBlk      blks[MAX_CFG_BLKS];
+    uint16_t    blks_len;
+} Cfg;
+
+// Stores the header of a saved Cfg, which is followed by its flags and then
+// its blocks. Fields are in host byte order.
+typedef struct __CFG_HDR__ {
+    char        magic[4];
+    uint16_t    ver;
+    uint16_t    blks_len;
+    uint64_t    hash;
+} CfgHdr;
+
+// Walk the program in a Ram from ADDR_PROG_START and build its Cfg.
+void build_cfg(Cfg *this, const Ram *ram);
+
+// Find the block starting at addr. Return data is its index, or -1 if no
+// block starts there.
+int32_t find_cfg_blk(const Cfg *this, uint16_t addr);
+
+// Save a Cfg to file.
+void sv_cfg(const Cfg *this, const char *fname, Err *err);
+
+// Load a Cfg from a file written by sv_cfg. Its blocks are checked to be in
+// range and in order, but not against any ROM; compare hash for that.
+void ld_cfg(Cfg *this, const char *fname, Err *err);
+
+#endif
@@ -9,15 +9,19 @@
 #include <stdint.h>
 
 // Stores a single clock. One should be used for system time, and another for
-// the delay and sound timers.
+// the delay and sound timers. A clock with a frequency of 0 is uncapped and
+// ticks on every update.
 typedef struct __CLK__ {
-    uint16_t    freq;
+    uint32_t    freq;
     uint64_t    ticks;
     uint64_t    next_tick;
 } Clk;
 
+// Get the wall-clock time in microseconds.
+uint64_t get_micros();
+
 // Initialize a clock with given frequency.
-void init_clk(Clk *this, uint16_t freq);
+void init_clk(Clk *this, uint32_t freq);
 
 // Start a clock.
 void start_clk(Clk *this);
@@ -25,4 +29,7 @@ void start_clk(Clk *this);
 // Update a clock. Return data indicates if the clock ticked.
 bool update_clk(Clk *this);
 
+// Sleep until a started clock is due to tick. Uncapped clocks return at once.
+void nap_clk(const Clk *this);
+
 #endif
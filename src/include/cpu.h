@@ -7,12 +7,35 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdio.h>
 
 #include "err.h"
-#include "graphic.h"
-#include "key.h"
 #include "ram.h"
+#include "vid.h"
+
+#define CPU_RNG_SEED            0x2545f491
+
+// Quirk bits, each taking the behavior of some CHIP-8 variant
+#define QUIRK_SHIFT_VY          0x01    // 8xy6 and 8xye shift Vy into Vx
+#define QUIRK_MEM_INC_I         0x02    // fx55 and fx65 leave I past Vx
+#define QUIRK_JP_VX             0x04    // bxnn jumps to xnn + Vx
+#define QUIRK_VF_RESET          0x08    // 8xy1, 8xy2 and 8xy3 clear VF
+#define QUIRK_CLIP              0x10    // Sprites clip at the screen edge
+
+#define QUIRKS_K8E              0
+#define QUIRKS_VIP              (QUIRK_SHIFT_VY | QUIRK_MEM_INC_I |         \
+                                QUIRK_VF_RESET | QUIRK_CLIP)
+#define QUIRKS_SCHIP            (QUIRK_JP_VX | QUIRK_CLIP)
+#define QUIRKS_XOCHIP           (QUIRK_SHIFT_VY | QUIRK_MEM_INC_I)
+
+// Lists quirk profiles. The interpreter is compiled once for each, with its
+// quirks fixed, so none are tested as it runs.
+typedef enum __QUIRK_PROF__ {
+    QUIRK_K8E,
+    QUIRK_VIP,
+    QUIRK_SCHIP,
+    QUIRK_XOCHIP,
+    QUIRK_PROF_LEN
+} QuirkProf;
 
 // Stores CPU registers and other state.
 typedef struct __CPU__ {
@@ -24,6 +47,8 @@ typedef struct __CPU__ {
     uint8_t     sp;
     uint16_t    stk[16];
     uint16_t    instr;
+    uint32_t    rng;
+    QuirkProf   quirks;
     bool        paused;
     bool        step;
 } Cpu;
@@ -31,7 +56,19 @@ typedef struct __CPU__ {
 // Initialize a Cpu.
 void init_cpu(Cpu *this);
 
-// Perform a single Cpu operation.
-void do_cpu_op(Cpu *this, Ram *ram, Win *win, KeySt *key_st, Err *err);
+// Perform a single Cpu operation, using the interpreter for its quirk
+// profile. The keys param is a bitmask of the keypad keys currently down,
+// with bit n set for key n.
+void do_cpu_op(Cpu *this, Ram *ram, Vid *vid, uint16_t keys, Err *err);
+
+// Get the quirk profile named "k8e", "vip", "schip" or "xochip". Return data
+// indicates if the name is known.
+bool get_quirk_prof(const char *name, QuirkProf *prof);
+
+// Get the name of a quirk profile.
+const char *get_quirk_name(QuirkProf prof);
+
+// Get the QUIRK_* bits of a quirk profile.
+uint8_t get_quirks(QuirkProf prof);
 
 #endif
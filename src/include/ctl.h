@@ -0,0 +1,112 @@
+// Copyright (C) 2024  KA Wright
+
+// ctl.h - Unix-socket control server
+
+#ifndef __CTL_H__
+#define __CTL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+#define MAX_CTL_CLIENTS         16
+#define MAX_CTL_BODY            (ADDR_PROG_END + 1)
+#define CTL_SLOTS               8           // Snapshots kept in memory
+#define CTL_SLICE               60          // Frames run between polls
+
+// Lists control requests. Each names what arg, addr and slot of a CtlReq
+// hold, what its body carries, and what the body of its reply carries.
+typedef enum __CTL_OP__ {
+    CTL_LOAD = 1,       // Body is a ROM image; resets the machine
+    CTL_RUN,            // Run arg frames; replies once they have run
+    CTL_KEYS,           // Hold the keypad keys in arg, bit n for key n
+    CTL_SAVE,           // Snapshot the machine into slot
+    CTL_RESTORE,        // Return the machine to the snapshot in slot
+    CTL_VID,            // Reply with the VID_H rows of the picture
+    CTL_RAM,            // Reply with arg bytes of RAM from addr
+    CTL_STATS,          // Reply with a CtlStats
+    CTL_QUIT            // Reply, then stop the server
+} CtlOp;
+
+// Stores the header of a request, followed by len bytes of body. Fields are
+// in host byte order.
+typedef struct __CTL_REQ__ {
+    uint8_t     op;
+    uint8_t     slot;
+    uint16_t    addr;
+    uint32_t    arg;
+    uint32_t    len;
+} CtlReq;
+
+// Stores the header of a reply, followed by len bytes of body. If code is
+// not ERR_OK, the body is the error message.
+typedef struct __CTL_RESP__ {
+    uint8_t     op;
+    uint8_t     code;
+    uint16_t    pad;
+    uint32_t    len;
+} CtlResp;
+
+// Stores the counters and registers returned by CTL_STATS.
+typedef struct __CTL_STATS__ {
+    uint64_t    frames;
+    uint64_t    idle_frames;            // Frames that ended in a spin wait
+    uint64_t    reqs;
+    uint32_t    cpf;
+    uint16_t    pc;
+    uint16_t    i_reg;
+    uint16_t    instr;
+    uint8_t     v_regs[16];
+    uint8_t     del_timer;
+    uint8_t     snd_timer;
+    uint8_t     sp;
+    uint8_t     clients;
+    uint8_t     pad[4];
+} CtlStats;
+
+_Static_assert(MAX_CTL_BODY >= sizeof(((Ram *) 0)->data),
+    "A CTL_RAM reply must fit in a client's output buffer");
+
+// Stores a connection and its unsent reply, with frames left to run for it.
+typedef struct __CTL_CLIENT__ {
+    int         fd;
+    uint32_t    ev;
+    uint32_t    in_len;
+    uint32_t    out_len;
+    uint32_t    out_off;
+    uint32_t    frames;
+    uint8_t     in[sizeof(CtlReq) + MAX_CTL_BODY];
+    uint8_t     out[sizeof(CtlResp) + MAX_CTL_BODY];
+} CtlClient;
+
+// Stores a control server driving one machine. Requests from each client
+// are handled in order, one at a time; clients take turns, and a long run
+// is split into slices so others are answered while it goes on.
+typedef struct __CTL__ {
+    int         lfd;
+    int         efd;
+    const char  *path;
+    Vm          *vm;
+    uint16_t    keys;
+    bool        quit;
+    CtlStats    stats;
+    bool        has_slot[CTL_SLOTS];
+    Vm          slots[CTL_SLOTS];
+    CtlClient   clients[MAX_CTL_CLIENTS];
+} Ctl;
+
+// Listen for clients on the Unix socket path, to drive vm at cpf
+// instructions a frame. A stale socket at path is replaced.
+void open_ctl(Ctl *this, const char *path, Vm *vm, uint32_t cpf, Err *err);
+
+// Serve requests until a client sends CTL_QUIT, or an error.
+void serve_ctl(Ctl *this, Err *err);
+
+// Close every connection and remove the socket.
+void close_ctl(Ctl *this);
+
+#endif
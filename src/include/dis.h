@@ -0,0 +1,63 @@
+// Copyright (C) 2024  KA Wright
+
+// dis.h - Instruction decoding and disassembly
+
+#ifndef __DIS_H__
+#define __DIS_H__
+
+#include <stdint.h>
+
+#define MAX_DIS_LEN             24
+
+// Lists every instruction form, one class per mnemonic and operand shape.
+typedef enum __OPCLS__ {
+    OP_SYS,
+    OP_CLS,
+    OP_RET,
+    OP_JP,
+    OP_CALL,
+    OP_SE_BYTE,
+    OP_SNE_BYTE,
+    OP_SE_REG,
+    OP_LD_BYTE,
+    OP_ADD_BYTE,
+    OP_LD_REG,
+    OP_OR,
+    OP_AND,
+    OP_XOR,
+    OP_ADD_REG,
+    OP_SUB,
+    OP_SHR,
+    OP_SUBN,
+    OP_SHL,
+    OP_SNE_REG,
+    OP_LD_I,
+    OP_JP_V0,
+    OP_RND,
+    OP_DRW,
+    OP_SKP,
+    OP_SKNP,
+    OP_LD_DT_GET,
+    OP_LD_K,
+    OP_LD_DT_SET,
+    OP_LD_ST,
+    OP_ADD_I,
+    OP_LD_F,
+    OP_LD_B,
+    OP_LD_MEM_SET,
+    OP_LD_MEM_GET,
+    OP_ILLEGAL,
+    OP_CLS_LEN
+} OpCls;
+
+// Get the class of an instruction.
+OpCls get_op_cls(uint16_t instr);
+
+// Get a short name for an OpCls, e.g. "ADD Vx, Vy".
+const char *get_op_cls_name(OpCls cls);
+
+// Write the assembly text of an instruction into out, which must hold at
+// least MAX_DIS_LEN chars.
+void dis_op(uint16_t instr, char *out);
+
+#endif
@@ -0,0 +1,41 @@
+// Copyright (C) 2024  KA Wright
+
+// dump.h - RAM dumps
+
+#ifndef __DUMP_H__
+#define __DUMP_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+
+#define HEX_DUMP_ROW            8       // Bytes per line of a hex dump
+
+// Lists RAM dump formats.
+typedef enum __DUMP_FMT__ {
+    DUMP_HEX,
+    DUMP_BIN,
+    DUMP_DIFF
+} DumpFmt;
+
+// Stores the dump format and a copy of RAM as of the last dump, or as of
+// ROM load before the first, which diff dumps compare against.
+typedef struct __DUMP__ {
+    DumpFmt     fmt;
+    uint32_t    seq;
+    uint8_t     prev[ADDR_PROG_END + 1];
+} Dump;
+
+// Initialize a Dump, taking ram as the baseline for the first diff.
+void init_dump(Dump *this, DumpFmt fmt, const Ram *ram);
+
+// Get the format named "hex", "bin" or "diff". Return data indicates if the
+// name is known.
+bool get_dump_fmt(const char *name, DumpFmt *fmt);
+
+// Write a Ram to a new dump file with a single write.
+void sv_dump(Dump *this, const Ram *ram, Err *err);
+
+#endif
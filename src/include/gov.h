@@ -0,0 +1,80 @@
+// Copyright (C) 2024  KA Wright
+
+// gov.h - Adaptive instructions-per-frame governor
+
+#ifndef __GOV_H__
+#define __GOV_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "turbo.h"
+#include "vm.h"
+
+#define GOV_MAX_SCALE           16      // Max budget, in nominal budgets
+#define GOV_PACED_FRAMES        60      // Frames a wait counts as recent
+#define GOV_CUT_RATE            8       // Budget closes 1/8 of a gap a frame
+
+// Lists governor decisions.
+typedef enum __GOV_ACT__ {
+    GOV_HOLD,
+    GOV_RAISE,
+    GOV_CUT
+} GovAct;
+
+// Stores running totals of the frames a Gov has decided.
+typedef struct __GOV_STATS__ {
+    uint64_t    frames;
+    uint64_t    idle_frames;            // Frames that reached a wait
+    uint64_t    busy_frames;            // Frames of a paced ROM that did not
+    uint64_t    budget;                 // Sum of the budgets given
+    uint64_t    work;                   // Sum of instructions before waits
+    uint64_t    draws;
+    uint32_t    raises;
+    uint32_t    cuts;
+} GovStats;
+
+// Stores the state of the governor, which sets the instruction budget of
+// each frame from how much of the last one the ROM needed. The work of a
+// frame is the instructions run before the ROM reached a spin wait (see
+// is_vm_idle), or before its last DRW if it never did. A ROM that has waited
+// recently is paced by the timers, so any budget over its work leaves its
+// speed unchanged; the budget is cut towards the work plus headroom, and
+// raised at once when a frame runs out. A ROM that never waits is held at
+// the nominal budget, as more would speed it up.
+typedef struct __GOV__ {
+    uint32_t    base_cpf;
+    uint32_t    max_cpf;
+    uint32_t    work;
+    uint32_t    last_draw;
+    uint32_t    since_wait;
+    bool        waited;
+    GovAct      act;
+    GovStats    stats;
+} Gov;
+
+// Initialize a Gov, taking the current budget of turbo as nominal.
+void init_gov(Gov *this, Turbo *turbo);
+
+// Note the instruction just run on vm, which started at pc, as part of the
+// current frame of turbo.
+static inline void note_gov_op(Gov *this, const Turbo *turbo, const Vm *vm,
+        uint16_t pc) {
+    if (this->waited) return;
+    if ((vm->cpu.instr & 0xf000) == 0xd000 && vm->cpu.pc != pc) {
+        this->last_draw = turbo->cyc + 1;
+        this->stats.draws++;
+    }
+    if (is_vm_idle(vm)) {
+        this->waited = true;
+        this->work = turbo->cyc + 1;
+    }
+}
+
+// Decide the budget of the next frame of turbo, at the end of a frame.
+void end_gov_frame(Gov *this, Turbo *turbo);
+
+// Print a summary of the decisions of a Gov.
+void print_gov_stats(const Gov *this);
+
+#endif
@@ -11,6 +11,8 @@
 #include <SDL2/SDL.h>
 
 #include "err.h"
+#include "perf.h"
+#include "vid.h"
 
 // Handles a single graphical window.
 typedef struct __WIN__ {
@@ -19,7 +21,6 @@ typedef struct __WIN__ {
     uint32_t        bg;
     uint32_t        fg;
     uint8_t         px_sz;
-    bool            px_map[64][32];
 } Win;
 
 // Initialize a Win.
@@ -34,8 +35,20 @@ void clear_win(Win *this, Err *err);
 // Close a Win.
 void close_win(Win *this);
 
-// Draw a pixel.
-bool draw_px(Win *win, uint8_t x, uint8_t y, Err *err);
+// Draw a pixel in the fg color.
+void draw_px(Win *win, uint8_t x, uint8_t y, Err *err);
+
+// Draw the full contents of a Vid to a Win, without showing it.
+void paint_win(Win *this, const Vid *vid, Err *err);
+
+// Draw the full contents of a Vid to a Win and show it.
+void draw_win(Win *this, const Vid *vid, Err *err);
+
+// Draw the counters of a period over the top-left corner of a Win, without
+// showing it: a bar for each subsystem's share of host time (CPU red, render
+// green, input blue, audio yellow, idle grey), then instructions per second,
+// frames presented and frames dropped.
+void draw_perf_win(Win *this, const PerfStats *stats, Err *err);
 
 // Draw changes to a Win.
 void redraw_win(Win *this);
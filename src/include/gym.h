@@ -0,0 +1,62 @@
+// Copyright (C) 2024  KA Wright
+
+// gym.h - Frame stepping and rewards for learning agents
+
+#ifndef __GYM_H__
+#define __GYM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "vid.h"
+#include "vm.h"
+
+#define GYM_OBS_WORDS           VID_H       // uint64_t words per observation
+#define MAX_GYM_TERMS           8
+
+// Stores one term of a reward: a value read from RAM, as len bytes from
+// addr, big-endian, or as len decimal digits of one byte each if bcd (as
+// fx33 writes them), and multiplied by scale.
+typedef struct __GYM_TERM__ {
+    uint16_t    addr;
+    uint8_t     len;
+    bool        bcd;
+    int32_t     scale;
+} GymTerm;
+
+// Stores the settings shared by every machine stepped with it: the
+// instructions run each frame, and the terms whose sum is the score. The
+// reward of a step is how much the score rose over it.
+typedef struct __GYM__ {
+    uint32_t    cpf;
+    uint8_t     len;
+    GymTerm     terms[MAX_GYM_TERMS];
+} Gym;
+
+// Initialize a Gym running cpf instructions a frame, with no reward terms.
+void init_gym(Gym *this, uint32_t cpf);
+
+// Add a reward term to a Gym. Return data indicates if there was room and
+// len is 1 to 4 bytes, or 1 to 9 digits if bcd.
+bool add_gym_term(Gym *this, uint16_t addr, uint8_t len, bool bcd,
+    int32_t scale);
+
+// Read the score of vm, the sum of the reward terms of a Gym.
+int64_t read_gym_score(const Gym *this, const Vm *vm);
+
+// Run frames whole frames of this with the keypad keys in keys held down, as
+// a bitmask with bit n for key n. The picture after the last frame is copied
+// to obs, GYM_OBS_WORDS rows with the leftmost pixel in the high bit, unless
+// obs is NULL. Return data is the reward over the step.
+int64_t step_vm(Vm *this, const Gym *gym, uint16_t keys, uint32_t frames,
+    uint64_t *obs, Err *err);
+
+// Step each of the len machines in this as step_vm does, machine n holding
+// keys[n]. Observations are written back to back into obs, which must hold
+// len * GYM_OBS_WORDS words, and rewards into rews, if not NULL. On an error
+// the machines after the one that raised it are not stepped.
+void step_vms(Vm *this, uint32_t len, const Gym *gym, const uint16_t *keys,
+    uint32_t frames, uint64_t *obs, int64_t *rews, Err *err);
+
+#endif
@@ -0,0 +1,26 @@
+// Copyright (C) 2024  KA Wright
+
+// hash.h - State hashing
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "vid.h"
+
+#define HASH_SEED               0xcbf29ce484222325  // FNV-1a 64 offset basis
+
+// Fold len bytes of data into the FNV-1a 64 hash h.
+uint64_t hash_bytes(uint64_t h, const void *data, size_t len);
+
+// Hash the pixels of a Vid, independent of host byte order.
+uint64_t hash_vid(const Vid *vid);
+
+// Hash the architectural registers of a Cpu (V0-VF, I, timers, pc, sp and
+// the stack). Host-side fields such as paused are not included.
+uint64_t hash_cpu(const Cpu *cpu);
+
+#endif
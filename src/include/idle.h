@@ -5,13 +5,23 @@
 #ifndef __IDLE_H__
 #define __IDLE_H__
 
+#include "brk.h"
 #include "clock.h"
-#include "cpu.h"
+#include "dump.h"
 #include "err.h"
+#include "jrnl.h"
 #include "key.h"
+#include "perf.h"
+#include "turbo.h"
+#include "vm.h"
 
-// Perform the idle loop until the next system clock tick.
-void do_idle_loop(Clk *clk, KeySt *key_st, Cpu *cpu, Ram *ram, Win *win, 
-    Err *err);
+// Perform the idle loop until the next system clock tick. If jrnl is not
+// NULL, the reverse step and reverse continue commands undo instructions
+// from it; reverse continue stops at breakpoints and watched writes in brk.
+// RAM dumps are written in the format of dump, and the fast-forward key
+// toggles turbo. Time spent pumping input is charged to perf, and the
+// overlay key toggles its overlay.
+void do_idle_loop(Clk *clk, KeySt *key_st, Vm *vm, Jrnl *jrnl, 
+    const Brk *brk, Dump *dump, Turbo *turbo, Perf *perf, Err *err);
 
 #endif
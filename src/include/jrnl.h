@@ -0,0 +1,70 @@
+// Copyright (C) 2024  KA Wright
+
+// jrnl.h - Undo journal for reverse execution
+
+#ifndef __JRNL_H__
+#define __JRNL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "vm.h"
+
+#define JRNL_ENTS               (1 << 18)   // Entries kept, a power of 2
+#define JRNL_DATA_SZ            (1 << 22)   // Bytes of saved RAM, stack and
+                                            // video, a power of 2
+
+// Lists the kinds of JrnlEnt. Each instruction entry also saves the Cpu
+// registers; the kind names what else it overwrote, saved in the data ring.
+typedef enum __JRNLKIND__ {
+    JRNL_OP,                // Registers only
+    JRNL_STK,               // One stack slot (CALL)
+    JRNL_RAM,               // RAM bytes (fx33, fx55)
+    JRNL_ROWS               // Framebuffer rows (DRW, CLS)
+} JrnlKind;
+
+// Stores the state overwritten by one instruction. The timers are saved too,
+// so undoing an instruction also undoes the ticks since it ran. For data
+// kinds, addr is the first stack slot, RAM address or row, and len the
+// number of bytes saved.
+typedef struct __JRNL_ENT__ {
+    uint32_t    rng;
+    uint16_t    pc;
+    uint16_t    i_reg;
+    uint16_t    addr;
+    uint16_t    len;
+    uint8_t     v_regs[16];
+    uint8_t     sp;
+    uint8_t     del_timer;
+    uint8_t     snd_timer;
+    uint8_t     kind;
+} JrnlEnt;
+
+// Stores a bounded undo journal. When either ring fills, the oldest entries
+// are dropped.
+typedef struct __JRNL__ {
+    JrnlEnt     *ents;
+    uint32_t    ent_head;
+    uint32_t    ent_tail;
+    uint8_t     *data;
+    uint32_t    data_head;
+    uint32_t    data_tail;
+} Jrnl;
+
+// Initialize a Jrnl, allocating its rings.
+void init_jrnl(Jrnl *this, Err *err);
+
+// Release the memory held by a Jrnl.
+void free_jrnl(Jrnl *this);
+
+// Save what the next instruction of vm, run with keys down, will overwrite.
+// Call just before it runs. An fx0a still waiting for a key changes nothing,
+// so is not recorded, and a long wait does not push out the history.
+void rec_jrnl(Jrnl *this, const Vm *vm, uint16_t keys);
+
+// Undo the most recent instruction on vm. Return data is the undone entry,
+// or NULL if the journal is empty.
+const JrnlEnt *undo_jrnl(Jrnl *this, Vm *vm);
+
+#endif
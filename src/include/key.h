@@ -5,23 +5,44 @@
 #ifndef __KEY_H__
 #define __KEY_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "err.h"
+
+// Keys for keypad keys 0 to f, by the characters they type on a US layout
+#define KEY_MAP_DEFAULT         ",789uiojklm.0p;/"
+
+// Command keys, which a keymap may not use
+#define KEY_CMDS                "bdfgqrstvx"
+
 // Stores info about the keyboard state.
 typedef struct __KEYST__ {
     int32_t         st_len;
     const uint8_t   *st;
+    uint32_t        held;
+    int32_t         map[16];
 } KeySt;
 
 // Initialize a KeySt.
 void init_key_st(KeySt *this);
 
-// Block until a supported key is pressed and return it.
-uint8_t poll_key();
+// Map the keypad keys 0 to f to the keys typing each character of keys, as
+// on a US layout. Unless keys is 16 supported characters, none of them a
+// command key, the map is unchanged and err is set.
+void set_key_map(KeySt *this, const char *keys, Err *err);
 
 // Read the state of a supported key. Unsupported keys always return false.
 bool read_key(KeySt *this, uint8_t key);
 
+// Read whether a command key ('a' to 'z') has gone down since the last call
+// for that key, so holding it down acts once.
+bool read_key_press(KeySt *this, uint8_t key);
+
+// Read the state of all 16 keypad keys as a bitmask, with bit n set when key
+// n is down.
+uint16_t read_keys(KeySt *this);
+
 // Update the keyboard state.
 void update_key_st();
 
@@ -0,0 +1,71 @@
+// Copyright (C) 2024  KA Wright
+
+// lane.h - Lockstep execution of many machines
+
+#ifndef __LANE_H__
+#define __LANE_H__
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+#define LANE_BLK                32          // Lanes per vector block
+
+// Stores the state of many machines running the same ROM. Registers are kept
+// in structure-of-arrays layout so that lanes which fetch the same opcode can
+// be stepped together with vector kernels. Lanes which diverge fall back to
+// do_cpu_op one at a time. While a block's lanes share a pc, the opcode is
+// fetched once from code, a copy of the loaded image, unless some lane has
+// written that address (tracked in wr_map). Lane RAM must therefore only be
+// changed by step_lanes or ld_lanes. Every lane shares the quirk profile of
+// the Vm they were loaded from.
+typedef struct __LANES__ {
+    uint32_t    len;
+    uint32_t    cap;
+    uint8_t     *v_regs[16];
+    uint16_t    *i_reg;
+    uint8_t     *del_timer;
+    uint8_t     *snd_timer;
+    uint16_t    *pc;
+    uint8_t     *sp;
+    uint16_t    *stk[16];
+    uint32_t    *rng;
+    uint16_t    *keys;
+    uint8_t     *halted;
+    uint32_t    *live;
+    Ram         *ram;
+    Vid         *vid;
+    QuirkProf   quirks;
+    uint8_t     code[ADDR_PROG_END + 1];
+    uint64_t    wr_map[(ADDR_PROG_END + 1) / 64];
+    uint64_t    vec_ops;
+    uint64_t    scl_ops;
+} Lanes;
+
+// Initialize a Lanes with room for len machines, at least 1.
+void init_lanes(Lanes *this, uint32_t len, Err *err);
+
+// Release the memory held by a Lanes.
+void free_lanes(Lanes *this);
+
+// Copy the state of a Vm into every lane of a Lanes.
+void ld_lanes(Lanes *this, const Vm *vm);
+
+// Execute n instructions on every lane which has not halted. A lane halts
+// when its instruction raises an error, and its ErrCode is kept in halted.
+void step_lanes(Lanes *this, uint32_t n);
+
+// Decrement the delay and sound timers of every lane.
+void tick_lanes(Lanes *this);
+
+// Copy the registers of a single lane into a Cpu.
+void dump_lane(const Lanes *this, uint32_t lane, Cpu *cpu);
+
+// Update the registers of a single lane from a Cpu.
+void apply_lane(Lanes *this, uint32_t lane, const Cpu *cpu);
+
+#endif
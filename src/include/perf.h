@@ -0,0 +1,78 @@
+// Copyright (C) 2024  KA Wright
+
+// perf.h - Subsystem timing counters
+
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "err.h"
+
+#define PERF_PERIOD_NS          1000000000  // Counters are totalled each 1 s
+
+// Lists the subsystems host time is split between.
+typedef enum __PERF_SYS__ {
+    PERF_CPU,
+    PERF_RENDER,
+    PERF_INPUT,
+    PERF_AUDIO,
+    PERF_IDLE,
+    PERF_SYS_LEN
+} PerfSys;
+
+// Stores the counters of one period. CPU time is what is left of the period
+// once the other subsystems are taken out, so instructions are never timed
+// one by one. Idle time is spent in the idle loop other than pumping input.
+typedef struct __PERF_STATS__ {
+    uint64_t    ns[PERF_SYS_LEN];
+    uint64_t    wall_ns;
+    uint64_t    frames;
+    uint64_t    presented;
+    uint64_t    dropped;                // Frames whose picture was not shown
+    uint64_t    ops;                    // Instructions executed
+} PerfStats;
+
+// Stores the counters of the current period, the last whole one, and the
+// file each period is written to, if any.
+typedef struct __PERF__ {
+    uint64_t    start_ns;
+    uint64_t    start_ops;
+    uint64_t    periods;
+    bool        shown;                  // If the overlay is on screen
+    PerfStats   cur;
+    PerfStats   last;
+    FILE        *fp;
+} Perf;
+
+// Initialize a Perf and start its first period.
+void init_perf(Perf *this);
+
+// Write each period of a Perf to fname from now on, one line each.
+void open_perf(Perf *this, const char *fname, Err *err);
+
+// Read the monotonic clock, unaffected by time adjustments, in nanoseconds.
+static inline uint64_t read_perf_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+// Charge the time since start, from read_perf_ns, to a subsystem.
+static inline void add_perf(Perf *this, PerfSys sys, uint64_t start) {
+    this->cur.ns[sys] += read_perf_ns() - start;
+}
+
+// Count the end of a frame, after ops instructions in all, which was
+// dropped if its picture was never shown. Return data indicates if a period
+// ended, and last was updated.
+bool tick_perf(Perf *this, uint64_t ops, bool dropped);
+
+// Stop writing the periods of a Perf.
+void close_perf(Perf *this, Err *err);
+
+#endif
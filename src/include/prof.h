@@ -0,0 +1,63 @@
+// Copyright (C) 2024  KA Wright
+
+// prof.h - Execution profiler
+
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+
+#define PROF_TOP_N              32      // Addresses listed in a report
+#define PROF_MAX_DRW            16      // Last DRW-per-frame bucket is 16+
+
+// Stores execution counts. Counters are indexed directly by the pc and by
+// the opcode's high nibble and low byte, so counting is branch-free; the
+// counts are only decoded into opcode classes when a report is written. The
+// low byte alone cannot tell 00e0 and 00ee from SYS calls such as 01e0, so
+// SYS calls with a nonzero x are counted as 0000. Each opcode also sums the
+// time it took, in instructions or, on timed runs, VIP machine cycles.
+typedef struct __PROF__ {
+    uint64_t    pc_hits[ADDR_PROG_END + 1];
+    uint64_t    op_hits[16 * 256];
+    uint64_t    op_cyc[16 * 256];
+    uint64_t    cyc;
+    bool        timed;
+    uint64_t    drw_hist[PROF_MAX_DRW + 1];
+    uint64_t    drw_total;
+    uint64_t    drw_max;
+    uint32_t    drw_frame;
+    uint64_t    frames;
+    uint64_t    instrs;
+} Prof;
+
+// Initialize a Prof. If timed, the times given to count_prof are VIP
+// machine cycles (see get_vip_cyc); if not, each instruction takes 1.
+void init_prof(Prof *this, bool timed);
+
+// Count one executed instruction, the address it was fetched from and the
+// time it took.
+static inline void count_prof(Prof *this, uint16_t pc, uint16_t instr,
+        uint32_t cyc) {
+    uint8_t     kk          = (uint16_t) (instr - 0x100) < 0xf00 ? 0 :
+        instr & 0xff;
+    uint16_t    op          = ((instr >> 4) & 0xf00) | kk;
+
+    this->pc_hits[pc & ADDR_PROG_END]++;
+    this->op_hits[op]++;
+    this->op_cyc[op] += cyc;
+    this->cyc += cyc;
+    this->drw_frame += (instr >> 12) == 0xd;
+    this->instrs++;
+}
+
+// Close the current 60 Hz frame, adding its DRW count to the histogram.
+void tick_prof(Prof *this);
+
+// Write a report of a Prof to file, disassembling from ram.
+void dump_prof(const Prof *this, const Ram *ram, Err *err);
+
+#endif
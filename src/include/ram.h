@@ -5,6 +5,9 @@
 #ifndef __RAM_H__
 #define __RAM_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "err.h"
 
 #define SPRITE_LEN              5
@@ -27,24 +30,30 @@
 #define ADDR_SPRITE_E           0x046
 #define ADDR_SPRITE_F           0x04b
 
-// Stores system RAM.
+// Stores system RAM, with the hash of the program as loaded.
 typedef struct __RAM__ {
     uint8_t     data[ADDR_PROG_END + 1];
     uint16_t    prog_len;
+    uint64_t    hash;
 } Ram;
 
 // Initialize a Ram.
 void init_ram(Ram *this);
 
-// Dump a Ram to file.
-void dump_ram(Ram *this, Err *err);
-
 // Load character data into a Ram.
 void ld_ram_char(Ram *this);
 
-// Load a binary file into a Ram.
+// Get the 4x5 sprites of the hex digits, 5 bytes each, as ld_ram_char loads
+// them.
+const uint8_t *get_ram_font();
+
+// Load a binary file into a Ram, and hash it.
 void ld_ram(Ram *this, char *fname, Err *err);
 
+// Load len bytes of program data into a Ram, e.g. from a mapped file, and
+// hash it.
+void ld_ram_buf(Ram *this, const uint8_t *buf, size_t len, Err *err);
+
 // Reset a Ram.
 void reset_ram(Ram *this);
 
@@ -0,0 +1,75 @@
+// Copyright (C) 2024  KA Wright
+
+// ring.h - Buffered background file writer
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "err.h"
+
+// Encodes one record drained from a Ring into fp, on the writer thread.
+// Return data indicates if the write succeeded.
+typedef bool (*RingEnc)(FILE *fp, const void *rec, void *ctx);
+
+// Stores a single-producer, single-consumer byte ring. The producer appends
+// with push_ring; a background thread drains the ring into a file, so the
+// producer only pays for a memcpy unless the ring is full. With an encoder,
+// the ring holds fixed-size records that are each encoded as they drain.
+typedef struct __RING__ {
+    unsigned char   *buf;
+    size_t          cap;
+    size_t          rec_len;
+    RingEnc         enc;
+    void            *ctx;
+    unsigned char   *rec;
+    _Atomic size_t  head;
+    _Atomic size_t  tail;
+    size_t          tail_seen;
+    atomic_bool     done;
+    FILE            *fp;
+    pthread_t       thr;
+    Err             err;
+} Ring;
+
+// Open fname for writing and start the writer thread of a Ring with room for
+// cap bytes, rounded up to a power of 2.
+void open_ring(Ring *this, const char *fname, size_t cap, Err *err);
+
+// Open a Ring as open_ring does, with each rec_len-byte record passed to enc
+// with ctx to be written, rather than written as is.
+void open_ring_enc(Ring *this, const char *fname, size_t cap, size_t rec_len,
+    RingEnc enc, void *ctx, Err *err);
+
+// Append len bytes to a Ring, waiting for the writer if it is full.
+void push_ring(Ring *this, const void *data, size_t len);
+
+// Append len bytes to a Ring if it has room. Return data indicates if they
+// were appended; a full ring is left as is rather than waited on.
+bool offer_ring(Ring *this, const void *data, size_t len);
+
+// Append len bytes to a Ring. The common case, where the bytes fit without
+// wrapping and the ring was last seen to have room, is inlined.
+static inline void put_ring(Ring *this, const void *data, size_t len) {
+    size_t head = atomic_load_explicit(&this->head, memory_order_relaxed);
+
+    if (this->cap - (head - this->tail_seen) < len ||
+            (head & (this->cap - 1)) + len > this->cap) {
+        push_ring(this, data, len);
+        return;
+    }
+    memcpy(this->buf + (head & (this->cap - 1)), data, len);
+    atomic_store_explicit(&this->head, head + len, memory_order_release);
+}
+
+// Write out everything pushed to a Ring, stop its thread and close its file.
+// Any error the writer ran into is reported in err.
+void close_ring(Ring *this, Err *err);
+
+#endif
@@ -0,0 +1,79 @@
+// Copyright (C) 2024  KA Wright
+
+// romdb.h - Per-ROM settings keyed by content hash
+
+#ifndef __ROMDB_H__
+#define __ROMDB_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+
+#define ROM_DB_FILE             ".k8e_roms"     // In the home directory
+#define MAX_ROM_ENTS            1024
+#define MAX_ROM_NAME_LEN        32
+#define ROM_KEYMAP_LEN          16
+#define TUNE_REF_CPF            1000    // Reference cycles per frame
+#define TUNE_FRAMES             600     // Default frames per calibration run
+
+// Flags for the settings a RomEnt holds.
+#define ROM_HAS_FREQ            0x01
+#define ROM_HAS_QUIRKS          0x02
+#define ROM_HAS_KEYMAP          0x04
+#define ROM_HAS_BG              0x08
+#define ROM_HAS_FG              0x10
+
+// Stores the known-good settings for one ROM. Only those flagged in has are
+// set; the rest are left to the command line or its defaults.
+typedef struct __ROM_ENT__ {
+    uint64_t    hash;
+    uint8_t     has;
+    uint16_t    clk_freq;
+    QuirkProf   quirks;
+    char        keymap[ROM_KEYMAP_LEN + 1];
+    uint32_t    bg;
+    uint32_t    fg;
+    char        name[MAX_ROM_NAME_LEN];
+} RomEnt;
+
+// Stores a ROM database. On disk it is a text file with one line per ROM:
+// the hash in hex, then any of name=, freq=, quirks=, keymap=, bg= and fg=.
+typedef struct __ROM_DB__ {
+    uint32_t    len;
+    RomEnt      ents[MAX_ROM_ENTS];
+} RomDb;
+
+// Initialize an empty RomDb.
+void init_rom_db(RomDb *this);
+
+// Get the default database path, in the home directory. Return data
+// indicates if there is a home directory to use.
+bool get_rom_db_path(char *buf, size_t len);
+
+// Load a database file into a RomDb. A missing file loads as empty, unless
+// must_exist is set.
+void ld_rom_db(RomDb *this, const char *fname, bool must_exist, Err *err);
+
+// Save a RomDb to file, replacing it whole.
+void sv_rom_db(const RomDb *this, const char *fname, Err *err);
+
+// Find the entry for a ROM hash. Return data is NULL if there is none.
+RomEnt *find_rom_ent(RomDb *this, uint64_t hash);
+
+// Find the entry for a ROM hash, adding an empty one if there is none.
+RomEnt *add_rom_ent(RomDb *this, uint64_t hash, Err *err);
+
+// Run a ROM headless with a fixed key script and find the lowest cycles per
+// frame at which the picture matches a run at TUNE_REF_CPF after every frame
+// where that run finished its work and waited on the delay timer. A ROM that
+// never waits is compared after every frame. Return data is that count plus
+// an eighth for headroom, or 0 if only the reference rate matches, which
+// means the ROM is not paced by the timers and has no such point.
+uint32_t tune_rom(const Ram *ram, QuirkProf quirks, uint32_t frames,
+    Err *err);
+
+#endif
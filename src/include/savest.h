@@ -9,8 +9,8 @@
 
 #include "cpu.h"
 #include "err.h"
-#include "graphic.h"
 #include "ram.h"
+#include "vid.h"
 
 // Models the structure of a savestate file.
 typedef struct __SV_ST__ {
@@ -31,7 +31,7 @@ typedef struct __SV_ST__ {
 void init_sv_st(SvSt *this);
 
 // Dump the current system state to a SvSt object.
-void dump_sv_st(SvSt *this, const Cpu *cpu, const Win *win, const Ram *ram); 
+void dump_sv_st(SvSt *this, const Cpu *cpu, const Vid *vid, const Ram *ram); 
 
 // Load a savestate file into a SvSt object.
 void ld_sv_st(SvSt *this, const char *fname, Err *err);
@@ -40,6 +40,6 @@ void ld_sv_st(SvSt *this, const char *fname, Err *err);
 void sv_sv_st(const SvSt *this, const char *fname, Err *err);
 
 // Update the system state based on a SvSt.
-void apply_sv_st(const SvSt *this, Cpu *cpu, Win *win, Ram *ram, Err *err);
+void apply_sv_st(const SvSt *this, Cpu *cpu, Vid *vid, Ram *ram, Err *err);
 
 #endif
@@ -0,0 +1,78 @@
+// Copyright (C) 2024  KA Wright
+
+// sess.h - Session recording and seeking
+
+#ifndef __SESS_H__
+#define __SESS_H__
+
+#include <stdint.h>
+
+#include "err.h"
+#include "vm.h"
+
+#define SESS_MAGIC              "K8ES"
+#define SESS_VER                2
+#define SESS_KF_FRAMES          60      // Frames between keyframes
+
+// Lists the kinds of SessEv.
+typedef enum __SESSEVKIND__ {
+    SESS_EV_KEYS,           // Keypad state changed
+    SESS_EV_TICK            // Timers ticked
+} SessEvKind;
+
+// Stores one input or timer event, stamped with the number of instructions
+// run before it.
+typedef struct __SESS_EV__ {
+    uint64_t    cyc;
+    uint16_t    keys;
+    uint8_t     kind;
+} SessEv;
+
+// Stores a full machine snapshot, the keys down and the index of the next
+// event at that point.
+typedef struct __SESS_KF__ {
+    uint64_t    cyc;
+    uint64_t    ev;
+    uint16_t    keys;
+    Vm          vm;
+} SessKf;
+
+// Stores a recorded session: the event log since the first keyframe, plus a
+// keyframe every SESS_KF_FRAMES frames. Any cycle can be reached by
+// restoring the keyframe before it and replaying the events headless.
+typedef struct __SESS__ {
+    SessEv      *evs;
+    uint64_t    evs_len;
+    uint64_t    evs_cap;
+    SessKf      *kfs;
+    uint64_t    kfs_len;
+    uint64_t    kfs_cap;
+    uint64_t    cyc;
+    uint16_t    keys;
+    uint32_t    frames;
+} Sess;
+
+// Initialize a Sess, taking its first keyframe from vm.
+void init_sess(Sess *this, const Vm *vm, Err *err);
+
+// Release the memory held by a Sess.
+void free_sess(Sess *this);
+
+// Record that the next instruction runs with keys down. Call just before it
+// runs.
+void rec_sess_op(Sess *this, uint16_t keys, Err *err);
+
+// Record a timer tick of vm, taking a keyframe if one is due. Call just
+// after tick_vm.
+void rec_sess_tick(Sess *this, const Vm *vm, Err *err);
+
+// Restore vm to its state after cyc instructions of a Sess.
+void seek_sess(const Sess *this, uint64_t cyc, Vm *vm, Err *err);
+
+// Save a Sess to file.
+void sv_sess(const Sess *this, const char *fname, Err *err);
+
+// Load a Sess from a file written by sv_sess.
+void ld_sess(Sess *this, const char *fname, Err *err);
+
+#endif
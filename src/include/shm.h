@@ -0,0 +1,79 @@
+// Copyright (C) 2024  KA Wright
+
+// shm.h - Live state export through POSIX shared memory
+
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+#include "ram.h"
+#include "turbo.h"
+#include "vid.h"
+#include "vm.h"
+
+#define SHM_MAGIC               "K8ES"
+#define SHM_VER                 1
+
+// Stores the layout of a state segment. Fields are in host byte order, at
+// fixed offsets, so readers in any language can map it. The writer makes seq
+// odd while it updates the rest; a reader copies what it needs between two
+// loads of seq and retries if they differ or are odd (see snap_shm).
+typedef struct __SHM_SEG__ {
+    char            magic[4];
+    uint16_t        ver;
+    uint16_t        seg_sz;
+    _Atomic uint32_t seq;
+    uint32_t        pad;
+
+    // Performance counters
+    uint64_t        frames;
+    uint64_t        ops;                // Not counting skipped spin waits
+    uint64_t        wall_us;            // Since the export was opened
+    uint32_t        cpf;                // Budget of framed runs, else 0
+    uint8_t         speed;
+    uint8_t         paused;
+    uint8_t         quirks;
+    uint8_t         pad2;
+
+    // Registers
+    uint8_t         v_regs[16];
+    uint16_t        i_reg;
+    uint16_t        pc;
+    uint16_t        instr;
+    uint8_t         del_timer;
+    uint8_t         snd_timer;
+    uint16_t        stk[16];
+    uint8_t         sp;
+    uint8_t         pad3[7];
+
+    // Picture, 1 bpp with the leftmost pixel in the high bit, and RAM
+    uint64_t        rows[VID_H];
+    uint8_t         ram[ADDR_PROG_END + 1];
+} ShmSeg;
+
+// Stores an open state export.
+typedef struct __SHM__ {
+    ShmSeg      *seg;
+    char        name[64];
+    uint64_t    start_us;
+} Shm;
+
+// Create the shared-memory object name (e.g. "/k8e") and map it.
+void open_shm(Shm *this, const char *name, Err *err);
+
+// Publish the state of vm and the counters of a frame to a Shm.
+void pub_shm(Shm *this, const Vm *vm, const Turbo *turbo, uint64_t frames,
+    uint64_t ops);
+
+// Copy a consistent snapshot of seg into out, as a reader would. Return data
+// indicates if one was taken within a bounded number of retries.
+bool snap_shm(const ShmSeg *seg, ShmSeg *out);
+
+// Unmap a Shm and remove its object.
+void close_shm(Shm *this);
+
+#endif
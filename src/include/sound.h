@@ -20,11 +20,13 @@ typedef struct __SND__ {
     bool        muted;
     uint32_t    freq;
     uint8_t     wav[PCM_RATE * DUR];
+    bool        wav_ready;
     snd_pcm_t   *pcm_dev;
     bool        playing;
 } Snd;
 
-// Initialize a Snd.
+// Initialize a Snd. Its tone is computed when first played, so silent and
+// muted runs never pay for it.
 void init_snd(Snd *this, uint32_t freq, bool muted);
 
 // Play the PC speaker at the given pitch.
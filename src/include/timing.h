@@ -0,0 +1,25 @@
+// Copyright (C) 2024  KA Wright
+
+// timing.h - COSMAC VIP instruction timing
+
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Machine cycles of the VIP's 1802, at 1.76 MHz / 8, in a 60 Hz frame, less
+// those taken by the display interrupt and its DMA
+#define VIP_FRAME_CYC           3668
+#define VIP_DISP_CYC            1096
+#define VIP_CPF                 (VIP_FRAME_CYC - VIP_DISP_CYC)
+
+// Get the machine cycles the VIP interpreter takes for the instruction cpu
+// has just run, which started at pc with vx in its Vx. Skips cost more when
+// taken, DRW costs more by row when not byte-aligned, and fx33, fx55 and
+// fx65 by the digits or registers they handle. The wait for the display
+// interrupt before a DRW is not counted.
+uint32_t get_vip_cyc(const Cpu *cpu, uint16_t pc, uint8_t vx);
+
+#endif
@@ -0,0 +1,76 @@
+// Copyright (C) 2024  KA Wright
+
+// trace.h - Binary execution trace
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ring.h"
+
+#define TRACE_MAGIC             "K8ET"
+#define TRACE_VER               1
+#define TRACE_RING_SZ           (16 << 20)  // Bytes buffered in memory
+
+// Stores the header at the start of a trace file, including the registers
+// before the first record.
+typedef struct __TRACE_HDR__ {
+    char        magic[4];
+    uint16_t    ver;
+    uint16_t    rec_sz;
+    uint8_t     v_regs[16];
+} TraceHdr;
+
+// Stores one executed instruction and the state after it ran. Fields are in
+// host byte order. Which registers an instruction changed is found offline,
+// by comparing with the previous record, to keep recording to a copy.
+typedef struct __TRACE_REC__ {
+    uint32_t    frame;
+    uint16_t    pc;
+    uint16_t    instr;
+    uint16_t    i_reg;
+    uint8_t     v_regs[16];
+    uint8_t     del_timer;
+    uint8_t     snd_timer;
+    uint8_t     sp;
+    uint8_t     pad[3];
+} TraceRec;
+
+_Static_assert(sizeof(TraceRec) == 32, "TraceRec must stay 32 bytes");
+
+// Stores an open trace.
+typedef struct __TRACE__ {
+    Ring        ring;
+    uint32_t    frame;
+} Trace;
+
+// Create a trace file and start writing to it in the background.
+void open_trace(Trace *this, const char *fname, const Cpu *cpu, Err *err);
+
+// Record the instruction just run from pc, with cpu holding the result.
+static inline void rec_trace(Trace *this, uint16_t pc, const Cpu *cpu) {
+    TraceRec rec;
+
+    rec.frame = this->frame;
+    rec.pc = pc;
+    rec.instr = cpu->instr;
+    rec.i_reg = cpu->i_reg;
+    memcpy(rec.v_regs, cpu->v_regs, sizeof(rec.v_regs));
+    rec.del_timer = cpu->del_timer;
+    rec.snd_timer = cpu->snd_timer;
+    rec.sp = cpu->sp;
+    memset(rec.pad, 0, sizeof(rec.pad));
+    put_ring(&this->ring, &rec, sizeof(rec));
+}
+
+// Advance the frame number stamped on later records.
+void tick_trace(Trace *this);
+
+// Flush and close a trace.
+void close_trace(Trace *this, Err *err);
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright (C) 2024  KA Wright
+
+// turbo.h - Fast-forward and uncapped speed
+
+#ifndef __TURBO_H__
+#define __TURBO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "cpu.h"
+#include "vm.h"
+
+#define TURBO_FF_SPEED          8       // Fast-forward speed without --speed
+#define TURBO_MAX_SPEED         64
+#define TURBO_TIMER_RATE        60      // Hz
+
+// Stores the emulation speed as a multiple of the configured clock
+// frequency, where 0 is uncapped. An uncapped run has no wall clock to pace
+// it, so its 60 Hz frames are counted in instructions instead. An adaptive
+// run is framed the same way, with the wall clock pacing frames rather than
+// instructions, and its budget of cpf instructions a frame set by a Gov. A
+// timed run is framed too, with its budget in VIP machine cycles.
+typedef struct __TURBO__ {
+    uint8_t     speed;
+    uint8_t     ff_speed;
+    uint16_t    clk_freq;
+    uint32_t    cpf;
+    uint32_t    cyc;
+    bool        adaptive;
+    bool        timed;
+    bool        changed;
+} Turbo;
+
+// Initialize a Turbo at the given speed. The fast-forward key toggles
+// between normal speed and this speed, or TURBO_FF_SPEED if it is 1. If
+// timed, clk_freq is unused and each frame is VIP_CPF machine cycles.
+void init_turbo(Turbo *this, uint8_t speed, uint16_t clk_freq, bool adaptive,
+    bool timed);
+
+// Switch between normal speed and fast-forward.
+void toggle_turbo(Turbo *this);
+
+// Set up and start the system and timer clocks for the current speed.
+void start_turbo_clks(Turbo *this, Clk *sys_clk, Clk *timer_clk);
+
+// Skip the rest of a framed run's frame if vm is in a spin wait.
+void skip_turbo_idle(Turbo *this, Vm *vm);
+
+// Charge the rest of the VIP cost of the instruction cpu has just run, which
+// started at pc with vx in its Vx, to a timed run. A DRW first waits out the
+// frame, as the VIP draws only after the display interrupt.
+void charge_turbo_op(Turbo *this, const Cpu *cpu, uint16_t pc, uint8_t vx);
+
+// Return data indicates if frames are counted in instructions or cycles, as
+// they are when uncapped, adaptive or timed.
+static inline bool is_turbo_framed(const Turbo *this) {
+    return this->speed == 0 || this->adaptive || this->timed;
+}
+
+// Count one instruction of a framed run. Return data indicates if a 60 Hz
+// frame has passed. Cycles charged past the end of a frame go to the next.
+static inline bool count_turbo(Turbo *this) {
+    if (++this->cyc < this->cpf) return false;
+    this->cyc -= this->cpf;
+    return true;
+}
+
+#endif
@@ -0,0 +1,39 @@
+// Copyright (C) 2024  KA Wright
+
+// vid.h - Video memory
+
+#ifndef __VID_H__
+#define __VID_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define VID_W                   64
+#define VID_H                   32
+
+// Stores the monochrome framebuffer at 1 bit per pixel. Each row is a single
+// word whose most significant bit is the leftmost pixel.
+typedef struct __VID__ {
+    uint64_t    rows[VID_H];
+    bool        dirty;
+} Vid;
+
+// Initialize a Vid.
+void init_vid(Vid *this);
+
+// Clear every pixel of a Vid.
+void clear_vid(Vid *this);
+
+// XOR an n-byte sprite onto a Vid at (x, y), wrapping at the screen edges.
+// Return data indicates if any lit pixel was erased.
+bool draw_vid(Vid *this, uint8_t x, uint8_t y, const uint8_t *spr, uint8_t n);
+
+// XOR a sprite as draw_vid does, but clip it at the screen edges. Only its
+// starting position wraps.
+bool draw_vid_clip(Vid *this, uint8_t x, uint8_t y, const uint8_t *spr,
+    uint8_t n);
+
+// Read a single pixel of a Vid.
+bool read_vid(const Vid *this, uint8_t x, uint8_t y);
+
+#endif
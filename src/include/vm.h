@@ -0,0 +1,64 @@
+// Copyright (C) 2024  KA Wright
+
+// vm.h - Whole-machine state
+
+#ifndef __VM_H__
+#define __VM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+#include "vid.h"
+
+// Stores a complete machine (registers, timers, RNG, video and RAM) in one
+// contiguous block, so that it can be copied with a single memcpy. The ram
+// field is kept last so a copy-on-write clone only copies what precedes it.
+typedef struct __VM__ {
+    Cpu         cpu;
+    Vid         vid;
+    const Ram   *cow;
+    Ram         ram;
+} Vm;
+
+// Initialize a Vm.
+void init_vm(Vm *this);
+
+// Get the Ram a Vm currently reads from.
+const Ram *read_vm_ram(const Vm *this);
+
+// Copy the whole of src into a Vm.
+void clone_vm(Vm *this, const Vm *src);
+
+// Copy src into a Vm, sharing the RAM of src until the first write to it.
+// The RAM of src must not change while any clone still shares it.
+void clone_vm_cow(Vm *this, const Vm *src);
+
+// Give a Vm its own copy of any RAM it shares.
+void own_vm_ram(Vm *this);
+
+// Perform a single Cpu operation on a Vm.
+void do_vm_op(Vm *this, uint16_t keys, Err *err);
+
+// Decrement the delay and sound timers of a Vm.
+void tick_vm(Vm *this);
+
+// Check whether a Vm is spinning where skip_vm_idle can skip: in a jump to
+// itself, or a loop that polls a running delay timer until it reaches zero.
+bool is_vm_idle(const Vm *this);
+
+// If a Vm is spinning in a jump to itself, or in a loop that polls the delay
+// timer until it reaches zero, advance it to where it would be after max
+// more instructions, which must all come before the next timer tick. Return
+// data is the number of instructions skipped, which is 0 if the Vm is not in
+// such a loop.
+uint32_t skip_vm_idle(Vm *this, uint32_t max);
+
+// Run a Vm headless for one 60 Hz frame of cyc instructions, then tick its
+// timers. Spin waits are skipped to the end of the frame. Return data
+// indicates if the frame ended in such a wait.
+bool run_vm_frame(Vm *this, uint16_t keys, uint32_t cyc, Err *err);
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (C) 2024  KA Wright
+
+// xlat.h - Runtime for ROMs translated to C by k8e-xlat
+
+#ifndef __XLAT_H__
+#define __XLAT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+#include "vm.h"
+
+struct __XLAT__;
+
+// Runs translated code from the pc of a Vm for at most cyc instructions.
+// Return data is the number run. It returns early at an address where no
+// translated block starts, or before an instruction it leaves to the
+// interpreter: one which would raise an error, wait for a key, or run code
+// that has been overwritten.
+typedef uint32_t (*XlatFn)(struct __XLAT__ *x, Vm *vm, uint16_t keys,
+    uint32_t cyc);
+
+// Stores a translated program. The image holds the ROM the code was
+// translated from, padded with zeros over any code found past its end, and
+// code_map has a bit set for every address holding translated code. The
+// code follows one quirk profile, which the Vm running it must share.
+typedef struct __XLAT_PROG__ {
+    XlatFn          fn;
+    const uint8_t   *img;
+    uint16_t        img_len;
+    uint16_t        rom_len;
+    uint64_t        hash;
+    const uint64_t  *code_map;
+    QuirkProf       quirks;
+} XlatProg;
+
+// Stores a translated program as it runs. Once anything writes over
+// translated code, smc is set and each block compares its bytes with the
+// image before it runs.
+typedef struct __XLAT__ {
+    const XlatProg  *prog;
+    bool            smc;
+} Xlat;
+
+// Initialize an Xlat.
+void init_xlat(Xlat *this, const XlatProg *prog);
+
+// Check whether any of len bytes from addr hold translated code.
+static inline bool is_xlat_code(const XlatProg *prog, uint16_t addr,
+        uint16_t len) {
+    for (uint16_t i = addr; i < addr + len && i <= ADDR_PROG_END; i++) {
+        if ((prog->code_map[i >> 6] >> (i & 63)) & 1) return true;
+    }
+    return false;
+}
+
+// Run a Vm headless for one 60 Hz frame of cyc instructions, using the
+// translated code wherever it can and do_vm_op elsewhere, then tick its
+// timers. Spin waits are skipped as in run_vm_frame.
+void run_xlat_frame(Xlat *this, Vm *vm, uint16_t keys, uint32_t cyc,
+    Err *err);
+
+// Entry point of a translated executable. It runs the program headless and
+// prints the framebuffer and register hashes that k8e-conform records.
+int main_xlat(const XlatProg *prog, int argc, char *argv[]);
+
+// Used by translated code. Leave the translated code at addr, handing back
+// undo instructions that were counted for the block but not run.
+#define XLAT_EXIT(addr, undo)   do {                                        \
+        vm->cpu.pc = (addr);                                                \
+        return cyc - left - (undo);                                         \
+    } while (0)
+
+// Used by translated code. Enter a block of n instructions at addr, if the
+// budget allows and its code is unchanged.
+#define XLAT_ENTER(addr, n)     do {                                        \
+        if (left < (n) || (x->smc && memcmp(mem + (addr), x->prog->img +    \
+                (addr) - ADDR_PROG_START, (n) * 2) != 0)) {                 \
+            XLAT_EXIT(addr, 0);                                             \
+        }                                                                   \
+        left -= (n);                                                        \
+    } while (0)
+
+#endif
@@ -0,0 +1,172 @@
+// Copyright (C) 2024  KA Wright
+
+// jrnl.c - Undo journal for reverse execution
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err.h"
+#include "jrnl.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+void init_jrnl(Jrnl *this, Err *err) {
+    this->ents = malloc(JRNL_ENTS * sizeof(JrnlEnt));
+    this->data = malloc(JRNL_DATA_SZ);
+    this->ent_head = 0;
+    this->ent_tail = 0;
+    this->data_head = 0;
+    this->data_tail = 0;
+    if (this->ents == NULL || this->data == NULL) {
+        free_jrnl(this);
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate undo journal");
+    }
+}
+
+void free_jrnl(Jrnl *this) {
+    free(this->ents);
+    free(this->data);
+    this->ents = NULL;
+    this->data = NULL;
+}
+
+// Drop the oldest entry.
+static void _drop_jrnl(Jrnl *this) {
+    this->data_tail += this->ents[this->ent_tail % JRNL_ENTS].len;
+    this->ent_tail++;
+}
+
+// Claim a new entry with room for len data bytes, dropping old entries as
+// needed.
+static JrnlEnt *_push_jrnl(Jrnl *this, uint16_t len) {
+    JrnlEnt *ent;
+
+    while (this->ent_head - this->ent_tail == JRNL_ENTS ||
+            JRNL_DATA_SZ - (this->data_head - this->data_tail) < len) {
+        _drop_jrnl(this);
+    }
+    ent = &this->ents[this->ent_head % JRNL_ENTS];
+    this->ent_head++;
+    ent->len = len;
+    return ent;
+}
+
+// Append len bytes to the data ring.
+static void _put_data(Jrnl *this, const void *src, uint16_t len) {
+    const uint8_t *p = src;
+
+    for (uint16_t i = 0; i < len; i++) {
+        this->data[(this->data_head + i) % JRNL_DATA_SZ] = p[i];
+    }
+    this->data_head += len;
+}
+
+// Remove the newest len bytes from the data ring into dst.
+static void _pop_data(Jrnl *this, void *dst, uint16_t len) {
+    uint8_t *p = dst;
+
+    this->data_head -= len;
+    for (uint16_t i = 0; i < len; i++) {
+        p[i] = this->data[(this->data_head + i) % JRNL_DATA_SZ];
+    }
+}
+
+void rec_jrnl(Jrnl *this, const Vm *vm, uint16_t keys) {
+    const Cpu   *cpu        = &vm->cpu;
+    const Ram   *ram        = read_vm_ram(vm);
+    uint16_t    pc          = cpu->pc & ADDR_PROG_END;
+    uint16_t    instr       = (ram->data[pc] << 8) +
+        ram->data[(pc + 1) & ADDR_PROG_END];
+    uint8_t     x           = (instr & 0x0f00) >> 8;
+    uint8_t     y           = cpu->v_regs[(instr & 0x00f0) >> 4];
+    uint8_t     kind        = JRNL_OP;
+    uint16_t    addr        = 0;
+    uint16_t    len         = 0;
+    JrnlEnt     *ent;
+
+    if ((instr & 0xf0ff) == 0xf00a && keys == 0) return;
+    if ((instr & 0xf000) == 0x2000 && cpu->sp < 15) {
+        kind = JRNL_STK;
+        addr = cpu->sp + 1;
+        len = sizeof(uint16_t);
+    } else if ((instr & 0xf0ff) == 0xf033 || (instr & 0xf0ff) == 0xf055) {
+        kind = JRNL_RAM;
+        addr = cpu->i_reg & ADDR_PROG_END;
+        len = (instr & 0xff) == 0x33 ? 3 : x + 1;
+        if (addr + len > ADDR_PROG_END + 1) len = ADDR_PROG_END + 1 - addr;
+    } else if ((instr & 0xf000) == 0xd000) {
+        kind = JRNL_ROWS;
+        addr = y & (VID_H - 1);
+        len = (instr & 0xf) * sizeof(uint64_t);
+    } else if (instr == 0x00e0) {
+        kind = JRNL_ROWS;
+        len = VID_H * sizeof(uint64_t);
+    }
+
+    ent = _push_jrnl(this, len);
+    ent->rng = cpu->rng;
+    ent->pc = cpu->pc;
+    ent->i_reg = cpu->i_reg;
+    ent->addr = addr;
+    memcpy(ent->v_regs, cpu->v_regs, sizeof(ent->v_regs));
+    ent->sp = cpu->sp;
+    ent->del_timer = cpu->del_timer;
+    ent->snd_timer = cpu->snd_timer;
+    ent->kind = kind;
+
+    switch (kind) {
+        case JRNL_STK:
+        _put_data(this, &cpu->stk[addr], len);
+        break;
+
+        case JRNL_RAM:
+        _put_data(this, ram->data + addr, len);
+        break;
+
+        case JRNL_ROWS:
+        for (uint16_t i = 0; i < len / sizeof(uint64_t); i++) {
+            _put_data(this, &vm->vid.rows[(addr + i) & (VID_H - 1)],
+                sizeof(uint64_t));
+        }
+        break;
+    }
+}
+
+const JrnlEnt *undo_jrnl(Jrnl *this, Vm *vm) {
+    Cpu         *cpu        = &vm->cpu;
+    JrnlEnt     *ent;
+
+    if (this->ent_head == this->ent_tail) return NULL;
+    this->ent_head--;
+    ent = &this->ents[this->ent_head % JRNL_ENTS];
+    cpu->rng = ent->rng;
+    cpu->pc = ent->pc;
+    cpu->i_reg = ent->i_reg;
+    memcpy(cpu->v_regs, ent->v_regs, sizeof(cpu->v_regs));
+    cpu->sp = ent->sp;
+    cpu->del_timer = ent->del_timer;
+    cpu->snd_timer = ent->snd_timer;
+    switch (ent->kind) {
+        case JRNL_STK:
+        _pop_data(this, &cpu->stk[ent->addr], ent->len);
+        break;
+
+        case JRNL_RAM:
+        own_vm_ram(vm);
+        _pop_data(this, vm->ram.data + ent->addr, ent->len);
+        break;
+
+        case JRNL_ROWS:
+        for (uint16_t i = ent->len / sizeof(uint64_t); i > 0; i--) {
+            _pop_data(this, &vm->vid.rows[(ent->addr + i - 1) &
+                (VID_H - 1)], sizeof(uint64_t));
+        }
+        vm->vid.dirty = true;
+        break;
+    }
+    return ent;
+}
@@ -4,133 +4,81 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 
+#include "err.h"
 #include "key.h"
 
 void init_key_st(KeySt *this) {
+    Err err;
+
+    init_err(&err);
     this->st_len    = 0;
     this->st        = NULL;
+    this->held      = 0;
+    set_key_map(this, KEY_MAP_DEFAULT, &err);
 }
 
-uint8_t poll_key() {
-    SDL_Event e;
-    while (SDL_PollEvent(&e) != 0) {
-        if (e.type == SDL_KEYDOWN) {
-            switch (e.key.keysym.sym) {
-                
-                case SDLK_7:
-                return 0x1;
-                
-                case SDLK_8:
-                return 0x2;
-    
-                case SDLK_9:
-                return 0x3;
-
-                case SDLK_0:
-                return 0xc;
-
-                case SDLK_u:
-                return 0x4;
-
-                case SDLK_i:
-                return 0x5;
-
-                case SDLK_o:
-                return 0x6;
-            
-                case SDLK_p:
-                return 0xd;
-
-                case SDLK_j:
-                return 0x7;
-
-                case SDLK_k:
-                return 0x8;
-
-                case SDLK_l:
-                return 0x9;
-
-                case SDLK_SEMICOLON:
-                return 0xe;
-
-                case SDLK_m:
-                return 0xa;
-
-                case SDLK_COMMA:
-                return 0x0;
+// Get the scancode of a key by the character it types on a US layout.
+static SDL_Scancode _get_scancode(char c) {
+    static const char           punct[]     = "-=[]\\;'`,./";
+    static const SDL_Scancode   codes[]     = {
+        SDL_SCANCODE_MINUS, SDL_SCANCODE_EQUALS, SDL_SCANCODE_LEFTBRACKET,
+        SDL_SCANCODE_RIGHTBRACKET, SDL_SCANCODE_BACKSLASH,
+        SDL_SCANCODE_SEMICOLON, SDL_SCANCODE_APOSTROPHE, SDL_SCANCODE_GRAVE,
+        SDL_SCANCODE_COMMA, SDL_SCANCODE_PERIOD, SDL_SCANCODE_SLASH
+    };
+    const char                  *p;
+
+    if (c >= 'a' && c <= 'z') return SDL_SCANCODE_A + (c - 'a');
+    if (c >= '1' && c <= '9') return SDL_SCANCODE_1 + (c - '1');
+    if (c == '0') return SDL_SCANCODE_0;
+    p = c != '\0' ? strchr(punct, c) : NULL;
+    return p != NULL ? codes[p - punct] : SDL_SCANCODE_UNKNOWN;
+}
 
-                case SDLK_PERIOD:
-                return 0xb;
+void set_key_map(KeySt *this, const char *keys, Err *err) {
+    int32_t map[16];
 
-                case SDLK_SLASH:
-                return 0xf;
+    if (strlen(keys) != 16) {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Keymap %s does not have 16 keys",
+            keys);
+        return;
+    }
+    for (uint8_t key = 0; key < 16; key++) {
+        map[key] = _get_scancode(keys[key]);
+        if (map[key] == SDL_SCANCODE_UNKNOWN) {
+            err->code = ERR_ARGV;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Unsupported key '%c' in "
+                "keymap %s", keys[key], keys);
+            return;
+        }
 
-            }
+        // Command keys are read by scancode too, so would act mid-game
+        if (strchr(KEY_CMDS, keys[key]) != NULL) {
+            err->code = ERR_ARGV;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Key '%c' in keymap %s is "
+                "a command key (%s)", keys[key], keys, KEY_CMDS);
+            return;
         }
     }
-    return 0x0;
+    memcpy(this->map, map, sizeof(map));
 }
 
 bool read_key(KeySt *this, uint8_t key) {
     if (this->st == NULL) {
         this->st = SDL_GetKeyboardState(&this->st_len);
     }
+    if (key < 16) {
+        return this->st[this->map[key]];
+    }
     switch (key) {
 
-        // KEYBOARD KEYS
-
-        case 0x1:
-        return this->st[SDL_SCANCODE_7];
-
-        case 0x2:
-        return this->st[SDL_SCANCODE_8];
-
-        case 0x3:
-        return this->st[SDL_SCANCODE_9];
-
-        case 0xc:
-        return this->st[SDL_SCANCODE_0];
-    
-        case 0x4:
-        return this->st[SDL_SCANCODE_U];
-
-        case 0x5:
-        return this->st[SDL_SCANCODE_I];
-
-        case 0x6:
-        return this->st[SDL_SCANCODE_O];
-
-        case 0xd:
-        return this->st[SDL_SCANCODE_P];
-        
-        case 0x7:
-        return this->st[SDL_SCANCODE_J];
-
-        case 0x8:
-        return this->st[SDL_SCANCODE_K];
-
-        case 0x9:
-        return this->st[SDL_SCANCODE_L];
-
-        case 0xe:
-        return this->st[SDL_SCANCODE_SEMICOLON];
-
-        case 0xa:
-        return this->st[SDL_SCANCODE_M];
-
-        case 0x0:
-        return this->st[SDL_SCANCODE_COMMA];
-
-        case 0xb:
-        return this->st[SDL_SCANCODE_PERIOD];
-
-        case 0xf:
-        return this->st[SDL_SCANCODE_SLASH];
-
         // COMMAND KEYS
 
         case 'q':                                   // Quit
@@ -151,12 +99,43 @@ bool read_key(KeySt *this, uint8_t key) {
         case 't':                                   // Dump Savestate
         return this->st[SDL_SCANCODE_T];
 
+        case 'b':                                   // Reverse Step
+        return this->st[SDL_SCANCODE_B];
+
+        case 'v':                                   // Reverse Continue
+        return this->st[SDL_SCANCODE_V];
+
+        case 'f':                                   // Fast-Forward
+        return this->st[SDL_SCANCODE_F];
+
+        case 'g':                                   // Stats Overlay
+        return this->st[SDL_SCANCODE_G];
+
         default:
         break;
     }
     return false; 
 }
 
+bool read_key_press(KeySt *this, uint8_t key) {
+    uint32_t    bit         = 1u << ((key - 'a') & 0x1f);
+    bool        down        = read_key(this, key);
+    bool        press       = down && (this->held & bit) == 0;
+
+    this->held = down ? this->held | bit : this->held & ~bit;
+    return press;
+}
+
+uint16_t read_keys(KeySt *this) {
+    uint16_t keys = 0;
+    for (uint8_t key = 0; key < 16; key++) {
+        if (read_key(this, key)) {
+            keys |= 1 << key;
+        }
+    }
+    return keys;
+}
+
 void update_key_st() {
     SDL_PumpEvents();
 }
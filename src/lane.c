@@ -0,0 +1,623 @@
+// Copyright (C) 2024  KA Wright
+
+// lane.c - Lockstep execution of many machines
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "lane.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+// Build the block stepper for both AVX2 and baseline x86-64, picked at load
+#if defined(__x86_64__) && defined(__linux__)
+#define LANE_KERN       __attribute__((target_clones("avx2", "default")))
+#else
+#define LANE_KERN
+#endif
+
+#define LANE_INLINE     static inline __attribute__((always_inline))
+
+// Lane groups are tracked as bitmasks
+_Static_assert(LANE_BLK == 32, "LANE_BLK must match the width of uint32_t");
+
+typedef uint8_t     U8x     __attribute__((vector_size(LANE_BLK)));
+typedef int8_t      M8x     __attribute__((vector_size(LANE_BLK)));
+typedef uint16_t    U16x    __attribute__((vector_size(LANE_BLK * 2)));
+typedef int16_t     M16x    __attribute__((vector_size(LANE_BLK * 2)));
+typedef uint32_t    U32x    __attribute__((vector_size(LANE_BLK * 4)));
+typedef int32_t     M32x    __attribute__((vector_size(LANE_BLK * 4)));
+
+static void *_alloc_lanes(size_t sz, Err *err) {
+    void *ptr;
+
+    // aligned_alloc requires a size which is a multiple of the alignment
+    sz = (sz + LANE_BLK - 1) & ~((size_t) LANE_BLK - 1);
+    ptr = aligned_alloc(LANE_BLK, sz);
+    if (ptr == NULL) {
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate lanes");
+        return NULL;
+    }
+    memset(ptr, 0, sz);
+    return ptr;
+}
+
+LANE_INLINE U8x _ld8(const uint8_t *src) {
+    U8x v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+LANE_INLINE U16x _ld16(const uint16_t *src) {
+    U16x v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+LANE_INLINE U32x _ld32(const uint32_t *src) {
+    U32x v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+LANE_INLINE void _st8(uint8_t *dst, M8x m, U8x v) {
+    U8x old = _ld8(dst);
+    v = (v & (U8x) m) | (old & ~(U8x) m);
+    memcpy(dst, &v, sizeof(v));
+}
+
+LANE_INLINE void _st16(uint16_t *dst, M16x m, U16x v) {
+    U16x old = _ld16(dst);
+    v = (v & (U16x) m) | (old & ~(U16x) m);
+    memcpy(dst, &v, sizeof(v));
+}
+
+LANE_INLINE void _st32(uint32_t *dst, M32x m, U32x v) {
+    U32x old = _ld32(dst);
+    v = (v & (U32x) m) | (old & ~(U32x) m);
+    memcpy(dst, &v, sizeof(v));
+}
+
+// Record that some lane wrote len bytes of RAM from addr on.
+LANE_INLINE void _mark_wr(Lanes *this, uint16_t addr, uint8_t len) {
+    for (uint16_t a = addr; a < addr + len && a <= ADDR_PROG_END; a++) {
+        this->wr_map[a / 64] |= (uint64_t) 1 << (a % 64);
+    }
+}
+
+LANE_INLINE bool _is_wr(const Lanes *this, uint16_t addr) {
+    return (this->wr_map[addr / 64] >> (addr % 64)) & 1;
+}
+
+// Execute one opcode on every lane of a block selected by the bitmask grp.
+// Register-only ops run as vector kernels; ops on per-lane RAM, video or stack
+// loop over the selected lanes directly. Return data indicates if the opcode
+// was run; if not, nothing is changed and do_cpu_op must handle it. That is
+// the case for fx0a and for any op which would raise an error on a selected
+// lane.
+LANE_INLINE bool _do_vec_op(Lanes *this, uint32_t base, uint16_t instr,
+        uint32_t grp) {
+    U32x        iota;
+    M32x        m32;
+    M16x        m;
+    uint8_t     x           = (instr & 0x0f00) >> 8;
+    uint8_t     y           = (instr & 0x00f0) >> 4;
+    uint8_t     n           = (instr & 0x000f);
+    uint8_t     kk          = (instr & 0x00ff);
+    uint16_t    nnn         = (instr & 0x0fff);
+    M8x         m8;
+    U16x        step;
+    U16x        pc          = _ld16(this->pc + base);
+    U8x         vx          = _ld8(this->v_regs[x] + base);
+    U8x         vy          = _ld8(this->v_regs[y] + base);
+    U16x        x16         = __builtin_convertvector(vx, U16x);
+    U16x        keys;
+    U32x        rng;
+    U8x         res;
+    M8x         flag        = (M8x) {};
+    M16x        skip        = (M16x) {};
+    uint32_t    lane;
+    uint32_t    j;
+    uint16_t    addr;
+
+    // Expand the bitmask into one mask element per lane
+    for (uint32_t j = 0; j < LANE_BLK; j++) {
+        iota[j] = j;
+    }
+    m32 = ((((U32x) {} + grp) >> iota) & 1) != 0;
+    m = __builtin_convertvector(m32, M16x);
+    m8 = __builtin_convertvector(m32, M8x);
+    step = (U16x) m & 2;
+
+    // The kernels follow the default quirks, so ops that other profiles
+    // change are left to do_cpu_op
+    if (this->quirks != QUIRK_K8E && ((instr >> 12) == 0x8 ||
+            (instr >> 12) == 0xd || (instr & 0xf0ff) == 0xf055 ||
+            (instr & 0xf0ff) == 0xf065)) {
+        return false;
+    }
+
+    switch (instr >> 12) {
+
+        case 0x0:
+
+        // 00e0 - CLS
+        if (nnn == 0x0e0) {
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                clear_vid(&this->vid[base + __builtin_ctz(b)]);
+            }
+            break;
+        }
+
+        // 00ee - RET
+        if (nnn == 0x0ee) {
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                if (this->sp[base + __builtin_ctz(b)] == 0) return false;
+            }
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                j = __builtin_ctz(b);
+                lane = base + j;
+                this->pc[lane] = this->stk[this->sp[lane]][lane];
+                this->sp[lane]--;
+            }
+            pc = _ld16(this->pc + base);
+        }
+
+        // 0nnn - SYS addr (Treat as NOP)
+        break;
+
+        // 1nnn - JP addr
+        case 0x1:
+        _st16(this->pc + base, m, (U16x) {} + nnn);
+        return true;
+
+        // 2nnn - CALL addr
+        case 0x2:
+        for (uint32_t b = grp; b != 0; b &= b - 1) {
+            if (this->sp[base + __builtin_ctz(b)] >= 15) return false;
+        }
+        for (uint32_t b = grp; b != 0; b &= b - 1) {
+            j = __builtin_ctz(b);
+            lane = base + j;
+            this->sp[lane]++;
+            this->stk[this->sp[lane]][lane] = this->pc[lane];
+            this->pc[lane] = nnn;
+        }
+        return true;
+
+        // 3xkk - SE Vx, byte
+        case 0x3:
+        skip = __builtin_convertvector(vx == kk, M16x);
+        break;
+
+        // 4xkk - SNE Vx, byte
+        case 0x4:
+        skip = __builtin_convertvector(vx != kk, M16x);
+        break;
+
+        // 5xy0 - SE Vx, Vy
+        case 0x5:
+        if (n != 0) return false;
+        skip = __builtin_convertvector(vx == vy, M16x);
+        break;
+
+        // 6xkk - LD Vx, byte
+        case 0x6:
+        _st8(this->v_regs[x] + base, m8, (U8x) {} + kk);
+        break;
+
+        // 7xkk - ADD Vx, byte
+        case 0x7:
+        _st8(this->v_regs[x] + base, m8, vx + kk);
+        break;
+
+        case 0x8:
+        switch (n) {
+
+            // 8xy0 - LD Vx, Vy
+            case 0x0:
+            res = vy;
+            break;
+
+            // 8xy1 - OR Vx, Vy
+            case 0x1:
+            res = vx | vy;
+            break;
+
+            // 8xy2 - AND Vx, Vy
+            case 0x2:
+            res = vx & vy;
+            break;
+
+            // 8xy3 - XOR Vx, Vy
+            case 0x3:
+            res = vx ^ vy;
+            break;
+
+            // 8xy4 - ADD Vx, Vy
+            case 0x4:
+            res = vx + vy;
+            flag = res < vx;
+            break;
+
+            // 8xy5 - SUB Vx, Vy
+            case 0x5:
+            res = vx - vy;
+            flag = vx >= vy;
+            break;
+
+            // 8xy6 - SHR Vx, {Vy}
+            case 0x6:
+            res = vx >> 1;
+            flag = (vx & 1) != 0;
+            break;
+
+            // 8xy7 - SUBN Vx, Vy
+            case 0x7:
+            res = vy - vx;
+            flag = vy >= vx;
+            break;
+
+            // 8xye - SHL Vx, {Vy}
+            case 0xe:
+            res = vx << 1;
+            flag = (vx & 0x80) != 0;
+            break;
+
+            default:
+            return false;
+        }
+        // VF is written last, so the flag wins when x is 0xf
+        _st8(this->v_regs[x] + base, m8, res);
+        if (n >= 0x4) {
+            _st8(this->v_regs[0xf] + base, m8, (U8x) flag & 1);
+        }
+        break;
+
+        // 9xy0 - SNE Vx, Vy
+        case 0x9:
+        if (n != 0) return false;
+        skip = __builtin_convertvector(vx != vy, M16x);
+        break;
+
+        // annn - LD I, addr
+        case 0xa:
+        _st16(this->i_reg + base, m, (U16x) {} + nnn);
+        break;
+
+        // cxkk - RND Vx, byte
+        case 0xc:
+        rng = _ld32(this->rng + base);
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        _st32(this->rng + base, __builtin_convertvector(m, M32x), rng);
+        _st8(this->v_regs[x] + base, m8,
+            __builtin_convertvector(rng, U8x) & kk);
+        break;
+
+        // dxyn - DRW Vx, Vy, nibble
+        case 0xd:
+        for (uint32_t b = grp; b != 0; b &= b - 1) {
+            if (this->i_reg[base + __builtin_ctz(b)] + n > ADDR_PROG_END + 1) {
+                return false;
+            }
+        }
+        for (uint32_t b = grp; b != 0; b &= b - 1) {
+            j = __builtin_ctz(b);
+            lane = base + j;
+            this->v_regs[0xf][lane] = draw_vid(&this->vid[lane], vx[j], vy[j],
+                this->ram[lane].data + this->i_reg[lane], n);
+        }
+        break;
+
+        // ex9e - SKP Vx, exa1 - SKNP Vx
+        case 0xe:
+        if (kk != 0x9e && kk != 0xa1) return false;
+        keys = _ld16(this->keys + base);
+        skip = (x16 < 16) & (((keys >> (x16 & 0xf)) & 1) != 0);
+        if (kk == 0xa1) skip = ~skip;
+        break;
+
+        case 0xf:
+        switch (kk) {
+
+            // fx07 - LD Vx, DT
+            case 0x07:
+            _st8(this->v_regs[x] + base, m8, _ld8(this->del_timer + base));
+            break;
+
+            // fx15 - LD DT, Vx
+            case 0x15:
+            _st8(this->del_timer + base, m8, vx);
+            break;
+
+            // fx18 - LD ST, Vx
+            case 0x18:
+            _st8(this->snd_timer + base, m8, vx);
+            break;
+
+            // fx1e - ADD I, Vx
+            case 0x1e:
+            _st16(this->i_reg + base, m, _ld16(this->i_reg + base) + x16);
+            break;
+
+            // fx29 - LD F, Vx
+            case 0x29:
+            _st16(this->i_reg + base, m & (x16 < 16), x16 * SPRITE_LEN);
+            break;
+
+            // fx33 - LD B, Vx
+            case 0x33:
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                if (this->i_reg[base + __builtin_ctz(b)] >= ADDR_PROG_END - 2) {
+                    return false;
+                }
+            }
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                j = __builtin_ctz(b);
+                lane = base + j;
+                addr = this->i_reg[lane];
+                _mark_wr(this, addr, 3);
+                this->ram[lane].data[addr] = vx[j] / 100;
+                this->ram[lane].data[addr + 1] = (vx[j] % 100) / 10;
+                this->ram[lane].data[addr + 2] = vx[j] % 10;
+            }
+            break;
+
+            // fx55 - LD [I], Vx
+            case 0x55:
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                if (this->i_reg[base + __builtin_ctz(b)] + x >= ADDR_PROG_END) {
+                    return false;
+                }
+            }
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                j = __builtin_ctz(b);
+                lane = base + j;
+                addr = this->i_reg[lane];
+                _mark_wr(this, addr, x + 1);
+                for (uint8_t k = 0; k <= x; k++) {
+                    this->ram[lane].data[addr + k] = this->v_regs[k][lane];
+                }
+            }
+            break;
+
+            // fx65 - LD Vx, [I]
+            case 0x65:
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                if (this->i_reg[base + __builtin_ctz(b)] + x >= ADDR_PROG_END) {
+                    return false;
+                }
+            }
+            for (uint32_t b = grp; b != 0; b &= b - 1) {
+                j = __builtin_ctz(b);
+                lane = base + j;
+                addr = this->i_reg[lane];
+                for (uint8_t k = 0; k <= x; k++) {
+                    this->v_regs[k][lane] = this->ram[lane].data[addr + k];
+                }
+            }
+            break;
+
+            default:
+            return false;
+        }
+        break;
+
+        default:
+        return false;
+    }
+    _st16(this->pc + base, m, pc + step + ((U16x) skip & step));
+    return true;
+}
+
+static void _do_scl_op(Lanes *this, uint32_t lane) {
+    Cpu         cpu;
+    Err         err;
+    uint16_t    pc          = this->pc[lane] & ADDR_PROG_END;
+    uint16_t    instr;
+
+    init_err(&err);
+    dump_lane(this, lane, &cpu);
+    instr = (this->ram[lane].data[pc] << 8) +
+        this->ram[lane].data[(pc + 1) & ADDR_PROG_END];
+    if ((instr & 0xf0ff) == 0xf033) {
+        _mark_wr(this, cpu.i_reg, 3);
+    } else if ((instr & 0xf0ff) == 0xf055) {
+        _mark_wr(this, cpu.i_reg, ((instr & 0x0f00) >> 8) + 1);
+    }
+    do_cpu_op(&cpu, &this->ram[lane], &this->vid[lane], this->keys[lane],
+        &err);
+    apply_lane(this, lane, &cpu);
+    if (is_err(&err)) {
+        this->halted[lane] = err.code;
+        this->live[lane / LANE_BLK] &= ~((uint32_t) 1 << (lane % LANE_BLK));
+    }
+}
+
+// Execute a single instruction on each lane of the block at base. Lanes are
+// grouped by the opcode they fetched, and each group is run together.
+LANE_KERN
+static void _step_blk(Lanes *this, uint32_t base) {
+    uint16_t        instr[LANE_BLK];
+    uint32_t        live        = this->live[base / LANE_BLK];
+    uint32_t        pend        = 0;
+    uint32_t        grp;
+    uint16_t        pc;
+    uint16_t        diff        = 0;
+    const uint16_t  *pcs        = this->pc + base;
+    const Ram       *ram        = this->ram + base;
+
+    if (live == 0) return;
+
+    // Common case: every live lane is at the same unmodified address
+    pc = pcs[__builtin_ctz(live)];
+    for (uint32_t i = 0; i < LANE_BLK; i++) {
+        diff |= (pcs[i] ^ pc) & -(uint16_t) ((live >> i) & 1);
+    }
+    if (diff == 0 && pc < ADDR_PROG_END && !_is_wr(this, pc) &&
+            !_is_wr(this, pc + 1)) {
+        instr[0] = (this->code[pc] << 8) + this->code[pc + 1];
+        if (_do_vec_op(this, base, instr[0], live)) {
+            this->vec_ops += __builtin_popcount(live);
+            return;
+        }
+        for (uint32_t b = live; b != 0; b &= b - 1) {
+            _do_scl_op(this, base + __builtin_ctz(b));
+        }
+        this->scl_ops += __builtin_popcount(live);
+        return;
+    }
+
+    for (uint32_t i = 0; i < LANE_BLK; i++) {
+        pc = pcs[i] & ADDR_PROG_END;
+        instr[i] = (ram[i].data[pc] << 8) + ram[i].data[(pc + 1) &
+            ADDR_PROG_END];
+    }
+    for (uint32_t b = live; b != 0; b &= b - 1) {
+        if (pcs[__builtin_ctz(b)] >= ADDR_PROG_END) {
+            _do_scl_op(this, base + __builtin_ctz(b));
+            continue;
+        }
+        pend |= b & -b;
+    }
+    while (pend != 0) {
+        grp = 0;
+        for (uint32_t i = 0; i < LANE_BLK; i++) {
+            grp |= (uint32_t) (instr[i] == instr[__builtin_ctz(pend)]) << i;
+        }
+        grp &= pend;
+        pend &= ~grp;
+        if (_do_vec_op(this, base, instr[__builtin_ctz(grp)], grp)) {
+            this->vec_ops += __builtin_popcount(grp);
+            continue;
+        }
+        for (uint32_t b = grp; b != 0; b &= b - 1) {
+            _do_scl_op(this, base + __builtin_ctz(b));
+        }
+        this->scl_ops += __builtin_popcount(grp);
+    }
+}
+
+void init_lanes(Lanes *this, uint32_t len, Err *err) {
+    memset(this, 0, sizeof(*this));
+    if (len == 0) {
+        err->code = ERR_ARGV;
+        strcpy(err->msg, "Expected at least 1 lane");
+        return;
+    }
+    this->len = len;
+    this->cap = (len + LANE_BLK - 1) & ~(LANE_BLK - 1);
+    for (int i = 0; i < 16; i++) {
+        this->v_regs[i] = _alloc_lanes(this->cap, err);
+        this->stk[i] = _alloc_lanes(this->cap * sizeof(uint16_t), err);
+    }
+    this->rng = _alloc_lanes(this->cap * sizeof(uint32_t), err);
+    this->i_reg = _alloc_lanes(this->cap * sizeof(uint16_t), err);
+    this->del_timer = _alloc_lanes(this->cap, err);
+    this->snd_timer = _alloc_lanes(this->cap, err);
+    this->pc = _alloc_lanes(this->cap * sizeof(uint16_t), err);
+    this->sp = _alloc_lanes(this->cap, err);
+    this->keys = _alloc_lanes(this->cap * sizeof(uint16_t), err);
+    this->halted = _alloc_lanes(this->cap, err);
+    this->live = _alloc_lanes(this->cap / LANE_BLK * sizeof(uint32_t), err);
+    this->ram = _alloc_lanes(this->cap * sizeof(Ram), err);
+    this->vid = _alloc_lanes(this->cap * sizeof(Vid), err);
+    if (is_err(err)) {
+        free_lanes(this);
+    }
+}
+
+void free_lanes(Lanes *this) {
+    for (int i = 0; i < 16; i++) {
+        free(this->v_regs[i]);
+        free(this->stk[i]);
+    }
+    free(this->rng);
+    free(this->i_reg);
+    free(this->del_timer);
+    free(this->snd_timer);
+    free(this->pc);
+    free(this->sp);
+    free(this->keys);
+    free(this->halted);
+    free(this->live);
+    free(this->ram);
+    free(this->vid);
+    memset(this, 0, sizeof(*this));
+}
+
+void ld_lanes(Lanes *this, const Vm *vm) {
+    memcpy(this->code, read_vm_ram(vm)->data, sizeof(this->code));
+    this->quirks = vm->cpu.quirks;
+    memset(this->wr_map, 0, sizeof(this->wr_map));
+    memset(this->live, 0, this->cap / LANE_BLK * sizeof(uint32_t));
+    for (uint32_t lane = 0; lane < this->len; lane++) {
+        apply_lane(this, lane, &vm->cpu);
+        this->ram[lane] = *read_vm_ram(vm);
+        this->vid[lane] = vm->vid;
+        this->keys[lane] = 0;
+        this->halted[lane] = ERR_OK;
+        this->live[lane / LANE_BLK] |= (uint32_t) 1 << (lane % LANE_BLK);
+    }
+}
+
+void step_lanes(Lanes *this, uint32_t n) {
+
+    // Run each block to completion in turn, so its state stays in cache
+    for (uint32_t base = 0; base < this->len; base += LANE_BLK) {
+        for (uint32_t i = 0; i < n; i++) {
+            _step_blk(this, base);
+        }
+    }
+}
+
+void tick_lanes(Lanes *this) {
+    U8x t;
+
+    for (uint32_t base = 0; base < this->cap; base += LANE_BLK) {
+        t = _ld8(this->del_timer + base);
+        t += (U8x) (t != 0);
+        memcpy(this->del_timer + base, &t, sizeof(t));
+        t = _ld8(this->snd_timer + base);
+        t += (U8x) (t != 0);
+        memcpy(this->snd_timer + base, &t, sizeof(t));
+    }
+}
+
+void dump_lane(const Lanes *this, uint32_t lane, Cpu *cpu) {
+    for (int i = 0; i < 16; i++) {
+        cpu->v_regs[i] = this->v_regs[i][lane];
+        cpu->stk[i] = this->stk[i][lane];
+    }
+    cpu->i_reg = this->i_reg[lane];
+    cpu->del_timer = this->del_timer[lane];
+    cpu->snd_timer = this->snd_timer[lane];
+    cpu->pc = this->pc[lane];
+    cpu->sp = this->sp[lane];
+    cpu->rng = this->rng[lane];
+    cpu->instr = 0;
+    cpu->quirks = this->quirks;
+    cpu->paused = false;
+    cpu->step = false;
+}
+
+void apply_lane(Lanes *this, uint32_t lane, const Cpu *cpu) {
+    for (int i = 0; i < 16; i++) {
+        this->v_regs[i][lane] = cpu->v_regs[i];
+        this->stk[i][lane] = cpu->stk[i];
+    }
+    this->i_reg[lane] = cpu->i_reg;
+    this->del_timer[lane] = cpu->del_timer;
+    this->snd_timer[lane] = cpu->snd_timer;
+    this->pc[lane] = cpu->pc;
+    this->sp[lane] = cpu->sp;
+    this->rng[lane] = cpu->rng;
+}
@@ -11,29 +11,73 @@
 
 #include "argv.h"
 #include "asset.h"
+#include "brk.h"
+#include "cap.h"
 #include "clean.h"
 #include "clock.h"
 #include "cpu.h"
+#include "ctl.h"
+#include "dump.h"
 #include "err.h"
+#include "gov.h"
 #include "graphic.h"
 #include "idle.h"
+#include "jrnl.h"
 #include "key.h"
+#include "perf.h"
+#include "prof.h"
 #include "ram.h"
+#include "romdb.h"
 #include "savest.h"
+#include "sess.h"
+#include "shm.h"
 #include "sound.h"
+#include "timing.h"
+#include "trace.h"
+#include "turbo.h"
+#include "vid.h"
+#include "vm.h"
 
 #define TIMER_RATE      60      // Hz
+#define STARTUP_FRAMES  600     // Frames --bench-startup waits for a picture
 
 // Entry Point
 int main(int argc, char *argv[]) {
     Argv        argv_obj;
+    Cap         cap;
+    Clk         disp_clk;
     Clk         sys_clk;
     Clk         timer_clk;
-    Cpu         cpu;
+    Dump        dump;
     Err         err;
+    Gov         gov;
     KeySt       key_st;
-    Ram         ram;
+    uint16_t    keys;
+    uint16_t    pc;
+    Perf        perf;
+    bool        perf_fresh  = false;
+    uint64_t    perf_ns;
+    Prof        prof;
+    bool        ran;
+    RomDb       rom_db;
+    char        rom_db_fn[256];
+    RomEnt      *rom_ent;
+    bool        skip_idle;
+    bool        tick;
+    Trace       trace;
+    Turbo       turbo;
+    Jrnl        jrnl;
+    Sess        sess;
+    Shm         shm;
+    uint64_t    frames      = 0;
+    uint64_t    ops         = 0;
+    uint64_t    start_us    = get_micros();
+    uint64_t    first_op_us = 0;
+    uint64_t    frame_us    = 0;
+    BrkHit      hit;
     Snd         snd;
+    Vm          vm;
+    uint8_t     vx          = 0;
     Win         win;
 
     // Argv Parsing
@@ -46,12 +90,11 @@ int main(int argc, char *argv[]) {
     }
     
     // Struct Initialization
-    init_cpu(&cpu);
+    init_vm(&vm);
+    init_prof(&prof, argv_obj.vip_timing);
     init_key_st(&key_st);
-    init_ram(&ram);
-    init_clk(&timer_clk, TIMER_RATE);
-    init_win(&win, argv_obj.bg, argv_obj.fg, argv_obj.px_sz);
-    init_clk(&sys_clk, argv_obj.clk_freq);
+    init_rom_db(&rom_db);
+    init_clk(&disp_clk, TIMER_RATE);
     init_snd(&snd, argv_obj.pitch, argv_obj.mute);    
 
     // Static Output Options
@@ -68,6 +111,24 @@ int main(int argc, char *argv[]) {
         return ERR_OK;
     }
 
+    // Headless Control Server (No SDL, so instances start cheaply)
+    if (argv_obj.control != NULL) {
+        static Ctl ctl;
+        ld_ram_char(&vm.ram);
+        if (argv_obj.fname != NULL) ld_ram(&vm.ram, argv_obj.fname, &err);
+        vm.cpu.quirks = argv_obj.quirks;
+        if (!is_err(&err)) {
+            open_ctl(&ctl, argv_obj.control, &vm, argv_obj.clk_freq /
+                TIMER_RATE, &err);
+        }
+        if (!is_err(&err)) {
+            serve_ctl(&ctl, &err);
+            close_ctl(&ctl);
+        }
+        err_alert(&err);
+        return err.code;
+    }
+
     // Resource Initialization and Setup
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         err.code = ERR_INIT;
@@ -75,8 +136,34 @@ int main(int argc, char *argv[]) {
         err_alert(&err);
         return err.code;
     }
-    ld_ram_char(&ram);
-    ld_ram(&ram, argv_obj.fname, &err);
+    ld_ram_char(&vm.ram);
+    ld_ram(&vm.ram, argv_obj.fname, &err);
+
+    // Per-ROM Settings, unless given on the command line
+    if (!is_err(&err)) {
+        if (argv_obj.romdb != NULL) {
+            ld_rom_db(&rom_db, argv_obj.romdb, true, &err);
+        } else if (get_rom_db_path(rom_db_fn, sizeof(rom_db_fn))) {
+            ld_rom_db(&rom_db, rom_db_fn, false, &err);
+        }
+    }
+    rom_ent = find_rom_ent(&rom_db, vm.ram.hash);
+    if (!is_err(&err) && rom_ent != NULL) {
+        apply_argv_rom(&argv_obj, rom_ent);
+    }
+    if (!is_err(&err) && argv_obj.keymap != NULL) {
+        set_key_map(&key_st, argv_obj.keymap, &err);
+    }
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    vm.cpu.quirks = argv_obj.quirks;
+    init_turbo(&turbo, argv_obj.speed, argv_obj.clk_freq, argv_obj.adaptive,
+        argv_obj.vip_timing);
+    init_gov(&gov, &turbo);
+    init_win(&win, argv_obj.bg, argv_obj.fg, argv_obj.px_sz);
+    init_dump(&dump, argv_obj.dump_fmt, &vm.ram);
     open_win(&win, &err);
     if (is_err(&err)) {
         err_alert(&err);
@@ -89,13 +176,13 @@ int main(int argc, char *argv[]) {
         return err.code;
     }
     redraw_win(&win);
-    start_clk(&sys_clk);
-    start_clk(&timer_clk);
+    start_turbo_clks(&turbo, &sys_clk, &timer_clk);
+    start_clk(&disp_clk);
     printf("\e[?25l");          // Hide cursor 
 
     // Initial Pause
     if (argv_obj.paused || (argv_obj.svst != NULL)) {
-        cpu.paused = true;
+        vm.cpu.paused = true;
     }
 
     // Load Savestate
@@ -108,7 +195,17 @@ int main(int argc, char *argv[]) {
             clean_res(&win);
             return err.code;
         }
-        apply_sv_st(&sv_st, &cpu, &win, &ram, &err);
+        apply_sv_st(&sv_st, &vm.cpu, &vm.vid, &vm.ram, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Start Undo Journal
+    if (argv_obj.rewind) {
+        init_jrnl(&jrnl, &err);
         if (is_err(&err)) {
             err_alert(&err);
             clean_res(&win);
@@ -116,62 +213,239 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Start Session Recording
+    if (argv_obj.sess != NULL) {
+        init_sess(&sess, &vm, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Start Trace
+    if (argv_obj.trace != NULL) {
+        open_trace(&trace, argv_obj.trace, &vm.cpu, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Start Screen Capture
+    if (argv_obj.record != NULL) {
+        open_cap(&cap, argv_obj.record, argv_obj.px_sz, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Start Performance Counters
+    init_perf(&perf);
+    if (argv_obj.perf != NULL) {
+        open_perf(&perf, argv_obj.perf, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Start State Export
+    if (argv_obj.shm != NULL) {
+        open_shm(&shm, argv_obj.shm, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            clean_res(&win);
+            return err.code;
+        }
+    }
+
+    // Idle loops may only be skipped when nothing observes each instruction
+    skip_idle = !argv_obj.brk.active && !argv_obj.profile && !argv_obj.rewind
+        && argv_obj.trace == NULL && argv_obj.sess == NULL;
+
     /***** MAIN PROGRAM LOOP *****/
     while (true) {
         
-        // Pause at Breakpoint
-        for (int i=0; i<argv_obj.brkpts_len; i++) {
-            if (argv_obj.brkpts[i] == cpu.pc) {
-                cpu.paused = true;
-                break;
+        // Pause at Breakpoint or Watchpoint
+        if (argv_obj.brk.active) {
+            hit = check_brk(&argv_obj.brk, &vm.cpu, read_vm_ram(&vm));
+            if (hit != BRK_HIT_NONE) {
+                vm.cpu.paused = true;
+            }
+            if (hit == BRK_HIT_READ || hit == BRK_HIT_WRITE) {
+                printf("\33[2K\rWATCH %s %03x AT PC %03x\n", hit == 
+                    BRK_HIT_READ ? "READ" : "WRITE", argv_obj.brk.hit_addr,
+                    vm.cpu.pc);
             }
         }
        
-        // Idle Loop (Timing, Input, Savestate & RAM Dump...) 
-        do_idle_loop(&sys_clk, &key_st, &cpu, &ram, &win, &err);
-        if (is_err(&err)) {
-            if (err.code != ERR_QUIT) err_alert(&err);
-            clean_res(&win);
-            return err.code;
+        // Idle Loop (Timing, Input, Savestate & RAM Dump...). Uncapped,
+        // adaptive and timed runs count frames in instructions or cycles and
+        // only visit it once per frame.
+        tick = is_turbo_framed(&turbo) && count_turbo(&turbo);
+        if (!is_turbo_framed(&turbo) || tick) {
+            perf_ns = read_perf_ns();
+            do_idle_loop(&sys_clk, &key_st, &vm, argv_obj.rewind ? &jrnl :
+                NULL, &argv_obj.brk, &dump, &turbo, &perf, &err);
+            add_perf(&perf, PERF_IDLE, perf_ns);
+            if (is_err(&err)) break;
+            if (turbo.changed) {
+                start_turbo_clks(&turbo, &sys_clk, &timer_clk);
+            }
+        }
+        if (!is_turbo_framed(&turbo)) {
+            tick = update_clk(&timer_clk);
+        }
+        if (tick && turbo.adaptive && !vm.cpu.paused) {
+            end_gov_frame(&gov, &turbo);
         }
-        if (update_clk(&timer_clk)) {
-            if (cpu.del_timer > 0) cpu.del_timer--;
-            if (cpu.snd_timer > 0) {
-                cpu.snd_timer--;
-            } else {
+        if (tick) {
+            tick_vm(&vm);
+            if (vm.cpu.snd_timer == 0 && snd.playing) {
+                perf_ns = read_perf_ns();
                 stop_snd(&snd);
+                add_perf(&perf, PERF_AUDIO, perf_ns);
+            }
+            if (tick_perf(&perf, ops, vm.vid.dirty) && perf.shown) {
+                perf_fresh = true;
+            }
+            if (argv_obj.profile) tick_prof(&prof);
+            if (argv_obj.trace != NULL) tick_trace(&trace);
+            if (argv_obj.record != NULL) rec_cap(&cap, &vm.vid);
+            frames++;
+            if (argv_obj.shm != NULL) pub_shm(&shm, &vm, &turbo, frames, ops);
+            if (argv_obj.bench_startup && frames >= STARTUP_FRAMES) break;
+            if (argv_obj.sess != NULL) {
+                rec_sess_tick(&sess, &vm, &err);
+                if (is_err(&err)) break;
             }
         }
 
         // Execute CPU Instruction
-        do_cpu_op(&cpu, &ram, &win, &key_st, &err);
-        if (is_err(&err)) {
-            err_alert(&err);
-            clean_res(&win);
-            return err.code;
+        pc = vm.cpu.pc;
+        ran = !vm.cpu.paused || vm.cpu.step;
+        if (turbo.timed) vx = vm.cpu.v_regs[read_vm_ram(&vm)->data[pc] & 0xf];
+        keys = read_keys(&key_st);
+        if (argv_obj.rewind && ran) {
+            rec_jrnl(&jrnl, &vm, keys);
         }
-        if (cpu.snd_timer > 0) {
-            play_snd(&snd, &err);
-            if (is_err(&err)) {
-                err_alert(&err);
-                clean_res(&win);
-                return err.code;
+        if (argv_obj.sess != NULL && ran) {
+            rec_sess_op(&sess, keys, &err);
+            if (is_err(&err)) break;
+        }
+        do_vm_op(&vm, keys, &err);
+        if (is_err(&err)) break;
+        ops += ran;
+        if (argv_obj.bench_startup && first_op_us == 0) {
+            first_op_us = get_micros();
+        }
+        if (argv_obj.profile && ran) {
+            count_prof(&prof, pc, vm.cpu.instr, turbo.timed ?
+                get_vip_cyc(&vm.cpu, pc, vx) : 1);
+        }
+        if (argv_obj.trace != NULL && ran) {
+            rec_trace(&trace, pc, &vm.cpu);
+        }
+        if (turbo.timed && ran) charge_turbo_op(&turbo, &vm.cpu, pc, vx);
+        if (turbo.adaptive && ran) note_gov_op(&gov, &turbo, &vm, pc);
+        if (skip_idle) skip_turbo_idle(&turbo, &vm);
+
+        // Present Video Changes (At most at the display rate in turbo),
+        // and the overlay once a period while it is shown
+        if ((vm.vid.dirty || perf_fresh) && (turbo.speed == 1 ||
+                update_clk(&disp_clk))) {
+            perf_ns = read_perf_ns();
+            paint_win(&win, &vm.vid, &err);
+            if (!is_err(&err) && perf.shown) {
+                draw_perf_win(&win, &perf.last, &err);
+            }
+            if (is_err(&err)) break;
+            redraw_win(&win);
+            add_perf(&perf, PERF_RENDER, perf_ns);
+            perf.cur.presented++;
+            vm.vid.dirty = false;
+            perf_fresh = false;
+            if (argv_obj.bench_startup) {
+                frame_us = get_micros();
+                break;
             }
         }
+        if (vm.cpu.snd_timer > 0 && !snd.playing && !snd.muted) {
+            perf_ns = read_perf_ns();
+            play_snd(&snd, &err);
+            add_perf(&perf, PERF_AUDIO, perf_ns);
+            if (is_err(&err)) break;
+        }
 
-        // Debug Output
-        if (argv_obj.debug) {
+        // Debug Output (Once per frame; use --trace for every instruction)
+        if (argv_obj.debug && (tick || vm.cpu.paused)) {
             printf("PC:%03x  INSTR:%04x  V:%02x %02x %02x %02x %02x %02x "
                 "%02x %02x %02x %02x %02x %02x %02x %02x %02x %02x  D:%02x  "
-                "S:%02x  SP:%02x  STK:%03x\r", cpu.pc, cpu.instr, 
-                cpu.v_regs[0x0], cpu.v_regs[0x1], cpu.v_regs[0x2], 
-                cpu.v_regs[0x3], cpu.v_regs[0x4], cpu.v_regs[0x5], 
-                cpu.v_regs[0x6], cpu.v_regs[0x7], cpu.v_regs[0x8], 
-                cpu.v_regs[0x9], cpu.v_regs[0xa], cpu.v_regs[0xb], 
-                cpu.v_regs[0xc], cpu.v_regs[0xd], cpu.v_regs[0xe], 
-                cpu.v_regs[0xf], cpu.del_timer, cpu.snd_timer, cpu.sp, 
-                cpu.stk[cpu.sp]);    
+                "S:%02x  SP:%02x  STK:%03x\r", vm.cpu.pc, vm.cpu.instr, 
+                vm.cpu.v_regs[0x0], vm.cpu.v_regs[0x1], vm.cpu.v_regs[0x2], 
+                vm.cpu.v_regs[0x3], vm.cpu.v_regs[0x4], vm.cpu.v_regs[0x5], 
+                vm.cpu.v_regs[0x6], vm.cpu.v_regs[0x7], vm.cpu.v_regs[0x8], 
+                vm.cpu.v_regs[0x9], vm.cpu.v_regs[0xa], vm.cpu.v_regs[0xb], 
+                vm.cpu.v_regs[0xc], vm.cpu.v_regs[0xd], vm.cpu.v_regs[0xe], 
+                vm.cpu.v_regs[0xf], vm.cpu.del_timer, vm.cpu.snd_timer, 
+                vm.cpu.sp, vm.cpu.stk[vm.cpu.sp]);    
         }
     }   
 
+    // Shutdown
+    if (err.code != ERR_QUIT) err_alert(&err);
+    clean_res(&win);
+    if (argv_obj.bench_startup && first_op_us != 0) {
+        printf("Startup: %.3f ms to first instruction, ", (first_op_us -
+            start_us) / 1000.0);
+        if (frame_us != 0) {
+            printf("%.3f ms to first frame\n", (frame_us - start_us) / 1000.0);
+        } else {
+            printf("no frame in %d frames\n", STARTUP_FRAMES);
+        }
+    }
+    if (argv_obj.adaptive) print_gov_stats(&gov);
+    if (argv_obj.trace != NULL) {
+        Err trace_err;
+        init_err(&trace_err);
+        close_trace(&trace, &trace_err);
+        err_alert(&trace_err);
+    }
+    if (argv_obj.record != NULL) {
+        Err cap_err;
+        init_err(&cap_err);
+        close_cap(&cap, &cap_err);
+        err_alert(&cap_err);
+    }
+    if (argv_obj.shm != NULL) {
+        close_shm(&shm);
+    }
+    if (argv_obj.perf != NULL) {
+        Err perf_err;
+        init_err(&perf_err);
+        close_perf(&perf, &perf_err);
+        err_alert(&perf_err);
+    }
+    if (argv_obj.rewind) {
+        free_jrnl(&jrnl);
+    }
+    if (argv_obj.sess != NULL) {
+        Err sess_err;
+        init_err(&sess_err);
+        sv_sess(&sess, argv_obj.sess, &sess_err);
+        err_alert(&sess_err);
+        free_sess(&sess);
+    }
+    if (argv_obj.profile) {
+        Err prof_err;
+        init_err(&prof_err);
+        dump_prof(&prof, read_vm_ram(&vm), &prof_err);
+        err_alert(&prof_err);
+    }
+    return err.code;
 }
@@ -0,0 +1,77 @@
+// Copyright (C) 2024  KA Wright
+
+// perf.c - Subsystem timing counters
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "err.h"
+#include "perf.h"
+
+void init_perf(Perf *this) {
+    memset(&this->cur, 0, sizeof(this->cur));
+    memset(&this->last, 0, sizeof(this->last));
+    this->start_ns = read_perf_ns();
+    this->start_ops = 0;
+    this->periods = 0;
+    this->shown = false;
+    this->fp = NULL;
+}
+
+void open_perf(Perf *this, const char *fname, Err *err) {
+    this->fp = fopen(fname, "w");
+    if (this->fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    fprintf(this->fp, "# period frames presented dropped ops/s cpu_us "
+        "render_us input_us audio_us idle_us\n");
+}
+
+bool tick_perf(Perf *this, uint64_t ops, bool dropped) {
+    PerfStats   *cur        = &this->cur;
+    uint64_t    now         = read_perf_ns();
+    uint64_t    other       = 0;
+
+    cur->frames++;
+    cur->dropped += dropped;
+    if (now - this->start_ns < PERF_PERIOD_NS) return false;
+
+    // Input is pumped inside the idle loop, so it is taken out of idle
+    cur->wall_ns = now - this->start_ns;
+    cur->ops = ops - this->start_ops;
+    cur->ns[PERF_IDLE] -= cur->ns[PERF_IDLE] > cur->ns[PERF_INPUT] ?
+        cur->ns[PERF_INPUT] : cur->ns[PERF_IDLE];
+    for (uint8_t i = PERF_CPU + 1; i < PERF_SYS_LEN; i++) {
+        other += cur->ns[i];
+    }
+    cur->ns[PERF_CPU] = cur->wall_ns > other ? cur->wall_ns - other : 0;
+    if (this->fp != NULL) {
+        fprintf(this->fp, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+            " %" PRIu64, this->periods, cur->frames, cur->presented,
+            cur->dropped, cur->ops * 1000000000 / cur->wall_ns);
+        for (uint8_t i = 0; i < PERF_SYS_LEN; i++) {
+            fprintf(this->fp, " %" PRIu64, cur->ns[i] / 1000);
+        }
+        fprintf(this->fp, "\n");
+    }
+    this->last = *cur;
+    memset(cur, 0, sizeof(*cur));
+    this->start_ns = now;
+    this->start_ops = ops;
+    this->periods++;
+    return true;
+}
+
+void close_perf(Perf *this, Err *err) {
+    if (this->fp == NULL) return;
+    if (fclose(this->fp) != 0) {
+        err->code = ERR_IO;
+        strcpy(err->msg, "Could not write performance counters");
+    }
+    this->fp = NULL;
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2024  KA Wright
+
+// prof.c - Execution profiler
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dis.h"
+#include "err.h"
+#include "prof.h"
+#include "ram.h"
+
+void init_prof(Prof *this, bool timed) {
+    memset(this, 0, sizeof(Prof));
+    this->timed = timed;
+}
+
+void tick_prof(Prof *this) {
+    uint32_t n = this->drw_frame;
+
+    this->drw_hist[n < PROF_MAX_DRW ? n : PROF_MAX_DRW]++;
+    if (n > this->drw_max) this->drw_max = n;
+    this->drw_total += n;
+    this->drw_frame = 0;
+    this->frames++;
+}
+
+static const uint64_t *_sort_hits;
+
+static int _cmp_hits(const void *a, const void *b) {
+    uint64_t x = _sort_hits[*(const uint16_t *) a];
+    uint64_t y = _sort_hits[*(const uint16_t *) b];
+    return (x < y) - (x > y);
+}
+
+static double _pct(uint64_t n, uint64_t total) {
+    return total == 0 ? 0 : 100.0 * n / total;
+}
+
+void dump_prof(const Prof *this, const Ram *ram, Err *err) {
+    uint16_t    addrs[ADDR_PROG_END + 1];
+    uint64_t    cls_hits[OP_CLS_LEN]    = {0};
+    uint64_t    cls_cyc[OP_CLS_LEN]     = {0};
+    uint16_t    instr;
+    char        dis[MAX_DIS_LEN];
+    char        fname[32];
+    FILE        *fp;
+
+    sprintf(fname, "k8e_profile_%lu.txt", (unsigned long) time(NULL));
+    fp = fopen(fname, "w");
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    fprintf(fp, "INSTRUCTIONS  %llu\nFRAMES        %llu\n\n",
+        (unsigned long long) this->instrs, (unsigned long long) this->frames);
+
+    // Hottest addresses
+    for (uint16_t i = 0; i <= ADDR_PROG_END; i++) {
+        addrs[i] = i;
+    }
+    _sort_hits = this->pc_hits;
+    qsort(addrs, ADDR_PROG_END + 1, sizeof(uint16_t), _cmp_hits);
+    fprintf(fp, "HOTTEST ADDRESSES\n");
+    fprintf(fp, "ADDR  INSTR  %-16s %14s %8s\n", "DISASSEMBLY", "COUNT",
+        "SHARE");
+    for (uint16_t i = 0; i < PROF_TOP_N; i++) {
+        if (this->pc_hits[addrs[i]] == 0) break;
+        instr = (ram->data[addrs[i]] << 8) + 
+            ram->data[(addrs[i] + 1) & ADDR_PROG_END];
+        dis_op(instr, dis);
+        fprintf(fp, "%03x   %04x   %-16s %14llu %7.2f%%\n", addrs[i], instr,
+            dis, (unsigned long long) this->pc_hits[addrs[i]],
+            _pct(this->pc_hits[addrs[i]], this->instrs));
+    }
+
+    // Opcode classes, by share of instructions and of emulated time. The
+    // two only match when each instruction takes one clock cycle, as they
+    // do unless timed.
+    for (uint16_t i = 0; i < 16 * 256; i++) {
+        instr = ((i & 0xf00) << 4) | (i & 0xff);
+        cls_hits[get_op_cls(instr)] += this->op_hits[i];
+        cls_cyc[get_op_cls(instr)] += this->op_cyc[i];
+    }
+    fprintf(fp, "\nOPCODE CLASSES (TIME IN %s)\n", this->timed ?
+        "VIP MACHINE CYCLES" : "INSTRUCTIONS");
+    fprintf(fp, "%-16s %14s %8s %14s %8s\n", "CLASS", "COUNT", "SHARE",
+        "TIME", "SHARE");
+    for (uint8_t c = 0; c < OP_CLS_LEN; c++) {
+        if (cls_hits[c] == 0) continue;
+        fprintf(fp, "%-16s %14llu %7.2f%% %14llu %7.2f%%\n",
+            get_op_cls_name(c), (unsigned long long) cls_hits[c],
+            _pct(cls_hits[c], this->instrs), (unsigned long long) cls_cyc[c],
+            _pct(cls_cyc[c], this->cyc));
+    }
+
+    // Draw calls per frame
+    fprintf(fp, "\nDRW PER FRAME (MEAN %.2f, MAX %llu)\n", this->frames == 0 ?
+        0 : (double) this->drw_total / this->frames,
+        (unsigned long long) this->drw_max);
+    fprintf(fp, "%-16s %14s %8s\n", "DRW", "FRAMES", "SHARE");
+    for (uint8_t n = 0; n <= PROF_MAX_DRW; n++) {
+        if (this->drw_hist[n] == 0) continue;
+        fprintf(fp, "%-2u%-14s %14llu %7.2f%%\n", n, n == PROF_MAX_DRW ? "+" :
+            "", (unsigned long long) this->drw_hist[n],
+            _pct(this->drw_hist[n], this->frames));
+    }
+    fclose(fp);
+    printf("Profile written to %s\n", fname);
+}
@@ -2,180 +2,96 @@
 
 // ram.c - RAM operations
 
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "err.h"
+#include "hash.h"
 #include "ram.h"
 
+// Stores the 4x5 sprites of the hex digits 0 to f, 5 bytes each
+static const uint8_t _font[] = {
+    0xf0, 0x90, 0x90, 0x90, 0xf0,     // 0
+    0x20, 0x60, 0x20, 0x20, 0x70,     // 1
+    0xf0, 0x10, 0xf0, 0x80, 0xf0,     // 2
+    0xf0, 0x10, 0xf0, 0x10, 0xf0,     // 3
+    0x90, 0x90, 0xf0, 0x10, 0x10,     // 4
+    0xf0, 0x80, 0xf0, 0x10, 0xf0,     // 5
+    0xf0, 0x80, 0xf0, 0x90, 0xf0,     // 6
+    0xf0, 0x10, 0x20, 0x40, 0x40,     // 7
+    0xf0, 0x90, 0xf0, 0x90, 0xf0,     // 8
+    0xf0, 0x90, 0xf0, 0x10, 0xf0,     // 9
+    0xf0, 0x90, 0xf0, 0x90, 0x90,     // A
+    0xe0, 0x90, 0xe0, 0x90, 0xe0,     // B
+    0xf0, 0x80, 0x80, 0x80, 0xf0,     // C
+    0xe0, 0x90, 0x90, 0x90, 0xe0,     // D
+    0xf0, 0x80, 0xf0, 0x80, 0xf0,     // E
+    0xf0, 0x80, 0xf0, 0x80, 0x80      // F
+};
+
 void init_ram(Ram *this) {
-    for (int i = 0; i <= ADDR_PROG_END; i++) {
-        this->data[i] = 0;
-    }
+    memset(this->data, 0, sizeof(this->data));
     this->prog_len = 0;
-}
-
-void dump_ram(Ram *this, Err *err) {
-    char fname[32];
-    sprintf(fname, "k8e_ram_dump_%lu.txt", (unsigned long) time(NULL));
-    FILE *fp = fopen(fname, "w");
-    if (fp == NULL) {
-        err->code = ERR_IO;
-        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
-        return;
-    }
-    for (int i = 0; i <= ADDR_PROG_END; i += 8) {
-        fprintf(fp, "@%03x    ", i);
-        for (int j = i; j < i + 8; j++) {
-            if (j >= ADDR_PROG_END) {
-                break;
-            }
-            fprintf(fp, "%02x ", this->data[j]);
-        }
-        fprintf(fp, "%s\n", "");
-    }
-    fclose(fp);
+    this->hash = 0;
 }
 
 void ld_ram_char(Ram *this) {
+    memcpy(this->data, _font, sizeof(_font));
+}
 
-    // 0
-    this->data[0x000] = 0xf0;
-    this->data[0x001] = 0x90;
-    this->data[0x002] = 0x90;
-    this->data[0x003] = 0x90;
-    this->data[0x004] = 0xf0;
-
-    // 1
-    this->data[0x005] = 0x20;
-    this->data[0x006] = 0x60;
-    this->data[0x007] = 0x20;
-    this->data[0x008] = 0x20;
-    this->data[0x009] = 0x70;
-
-    // 2
-    this->data[0x00a] = 0xf0;
-    this->data[0x00b] = 0x10;
-    this->data[0x00c] = 0xf0;
-    this->data[0x00d] = 0x80;
-    this->data[0x00e] = 0xf0;
-
-    // 3
-    this->data[0x00f] = 0xf0;
-    this->data[0x010] = 0x10;
-    this->data[0x011] = 0xf0;
-    this->data[0x012] = 0x10;
-    this->data[0x013] = 0xf0;
-
-    // 4
-    this->data[0x014] = 0x90;
-    this->data[0x015] = 0x90;
-    this->data[0x016] = 0xf0;
-    this->data[0x017] = 0x10;
-    this->data[0x018] = 0x10;
-
-    // 5
-    this->data[0x019] = 0xf0;
-    this->data[0x01a] = 0x80;
-    this->data[0x01b] = 0xf0;
-    this->data[0x01c] = 0x10;
-    this->data[0x01d] = 0xf0;
-    
-    // 6
-    this->data[0x01e] = 0xf0;
-    this->data[0x01f] = 0x80;
-    this->data[0x020] = 0xf0;
-    this->data[0x021] = 0x90;
-    this->data[0x022] = 0xf0;
-    
-    // 7
-    this->data[0x023] = 0xf0;
-    this->data[0x024] = 0x10;
-    this->data[0x025] = 0x20;
-    this->data[0x026] = 0x40;
-    this->data[0x027] = 0x40;
-    
-    // 8
-    this->data[0x028] = 0xf0;
-    this->data[0x029] = 0x90;
-    this->data[0x02a] = 0xf0;
-    this->data[0x02b] = 0x90;
-    this->data[0x02c] = 0xf0;
-    
-    // 9
-    this->data[0x02d] = 0xf0;
-    this->data[0x02e] = 0x90;
-    this->data[0x02f] = 0xf0;
-    this->data[0x030] = 0x10;
-    this->data[0x031] = 0xf0;
-    
-    // A
-    this->data[0x032] = 0xf0;
-    this->data[0x033] = 0x90;
-    this->data[0x034] = 0xf0;
-    this->data[0x035] = 0x90;
-    this->data[0x036] = 0x90;
-    
-    // B
-    this->data[0x037] = 0xe0;
-    this->data[0x038] = 0x90;
-    this->data[0x039] = 0xe0;
-    this->data[0x03a] = 0x90;
-    this->data[0x03b] = 0xe0;
-    
-    // C
-    this->data[0x03c] = 0xf0;
-    this->data[0x03d] = 0x80;
-    this->data[0x03e] = 0x80;
-    this->data[0x03f] = 0x80;
-    this->data[0x040] = 0xf0;
-    
-    // D
-    this->data[0x041] = 0xe0;
-    this->data[0x042] = 0x90;
-    this->data[0x043] = 0x90;
-    this->data[0x044] = 0x90;
-    this->data[0x045] = 0xe0;
-    
-    // E
-    this->data[0x046] = 0xf0;
-    this->data[0x047] = 0x80;
-    this->data[0x048] = 0xf0;
-    this->data[0x049] = 0x80;
-    this->data[0x04a] = 0xf0;
-    
-    // F
-    this->data[0x04b] = 0xf0;
-    this->data[0x04c] = 0x80;
-    this->data[0x04d] = 0xf0;
-    this->data[0x04e] = 0x80;
-    this->data[0x04f] = 0x80;
+const uint8_t *get_ram_font() {
+    return _font;
 }
 
 void ld_ram(Ram *this, char *fname, Err *err) {
-    FILE *fp = fopen(fname, "rb");
-    if (fp == NULL) {
+    struct stat st;
+    int         fd          = open(fname, O_RDONLY);
+
+    if (fd < 0) {
         err->code = ERR_IO;
         snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
         return;
     }
-    fseek(fp, 0, SEEK_END);
-    this->prog_len = ftell(fp);
-    if (this->prog_len > (ADDR_PROG_END - ADDR_PROG_START + 1)) {
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not read file %s", fname);
+        return;
+    }
+    if (st.st_size > (ADDR_PROG_END - ADDR_PROG_START + 1)) {
+        close(fd);
         err->code = ERR_DATA;
         snprintf(err->msg, MAX_ERR_MSG_LEN, "File %s too large", fname);
         return;
-    } 
-    fseek(fp, 0, SEEK_SET);
-    if (fread(this->data + ADDR_PROG_START, this->prog_len, 1, fp) != 1) {
+    }
+
+    // Read straight into RAM; a ROM is too small to be worth mapping
+    if (read(fd, this->data + ADDR_PROG_START, st.st_size) != st.st_size) {
+        close(fd);
         err->code = ERR_IO;
         snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not read file %s", fname);
         return;
     }
-    fclose(fp);
+    close(fd);
+    this->prog_len = st.st_size;
+    this->hash = hash_bytes(HASH_SEED, this->data + ADDR_PROG_START,
+        this->prog_len);
+}
+
+void ld_ram_buf(Ram *this, const uint8_t *buf, size_t len, Err *err) {
+    if (len > (ADDR_PROG_END - ADDR_PROG_START + 1)) {
+        err->code = ERR_DATA;
+        strcpy(err->msg, "Program too large");
+        return;
+    }
+    memcpy(this->data + ADDR_PROG_START, buf, len);
+    this->prog_len = len;
+    this->hash = hash_bytes(HASH_SEED, buf, len);
 }
 
 void reset_ram(Ram *this) {
@@ -0,0 +1,170 @@
+// Copyright (C) 2024  KA Wright
+
+// ring.c - Buffered background file writer
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "err.h"
+#include "ring.h"
+
+#define RING_IDLE_NS            1000000     // Writer sleep when empty
+
+// Pass the record at tail to the encoder of a Ring.
+static void _enc_rec(Ring *this, size_t tail) {
+    size_t          off         = tail & (this->cap - 1);
+    size_t          first       = this->cap - off;
+    const void      *rec        = this->buf + off;
+
+    if (first < this->rec_len) {
+        memcpy(this->rec, this->buf + off, first);
+        memcpy(this->rec + first, this->buf, this->rec_len - first);
+        rec = this->rec;
+    }
+    if (!this->enc(this->fp, rec, this->ctx) && !is_err(&this->err)) {
+        this->err.code = ERR_IO;
+        strcpy(this->err.msg, "Could not write to file");
+    }
+}
+
+// Drain the ring into its file until it is closed.
+static void *_run_writer(void *arg) {
+    Ring            *this       = arg;
+    size_t          tail        = atomic_load(&this->tail);
+    size_t          head;
+    size_t          off;
+    size_t          len;
+    struct timespec idle        = {0, RING_IDLE_NS};
+
+    while (true) {
+        head = atomic_load_explicit(&this->head, memory_order_acquire);
+        if (head == tail) {
+
+            // Anything pushed before done was set is visible on a reload
+            if (atomic_load(&this->done)) {
+                if (atomic_load(&this->head) == tail) break;
+                continue;
+            }
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        // Records are pushed whole, so there is at least one to encode
+        if (this->enc != NULL) {
+            _enc_rec(this, tail);
+            tail += this->rec_len;
+            atomic_store_explicit(&this->tail, tail, memory_order_release);
+            continue;
+        }
+
+        // Write up to the end of the buffer, then wrap on the next pass
+        off = tail & (this->cap - 1);
+        len = head - tail;
+        if (len > this->cap - off) len = this->cap - off;
+        if (fwrite(this->buf + off, len, 1, this->fp) != 1 && 
+                !is_err(&this->err)) {
+            this->err.code = ERR_IO;
+            strcpy(this->err.msg, "Could not write to file");
+        }
+        tail += len;
+        atomic_store_explicit(&this->tail, tail, memory_order_release);
+    }
+    return NULL;
+}
+
+void open_ring(Ring *this, const char *fname, size_t cap, Err *err) {
+    open_ring_enc(this, fname, cap, 0, NULL, NULL, err);
+}
+
+void open_ring_enc(Ring *this, const char *fname, size_t cap, size_t rec_len,
+        RingEnc enc, void *ctx, Err *err) {
+    size_t sz = 1;
+
+    while (sz < cap) sz <<= 1;
+    init_err(&this->err);
+    this->cap = sz;
+    this->rec_len = rec_len;
+    this->enc = enc;
+    this->ctx = ctx;
+    this->rec = NULL;
+    atomic_init(&this->head, 0);
+    atomic_init(&this->tail, 0);
+    this->tail_seen = 0;
+    atomic_init(&this->done, false);
+    this->buf = malloc(sz);
+    if (this->buf == NULL) {
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate ring buffer");
+        return;
+    }
+    if (enc != NULL && (this->rec = malloc(rec_len)) == NULL) {
+        free(this->buf);
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate ring buffer");
+        return;
+    }
+    this->fp = fopen(fname, "wb");
+    if (this->fp == NULL) {
+        free(this->rec);
+        free(this->buf);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    if (pthread_create(&this->thr, NULL, _run_writer, this) != 0) {
+        fclose(this->fp);
+        free(this->rec);
+        free(this->buf);
+        err->code = ERR_SUBSYS;
+        strcpy(err->msg, "Could not start writer thread");
+    }
+}
+
+void push_ring(Ring *this, const void *data, size_t len) {
+    size_t  head    = atomic_load_explicit(&this->head, memory_order_relaxed);
+    size_t  off     = head & (this->cap - 1);
+    size_t  first   = len < this->cap - off ? len : this->cap - off;
+
+    this->tail_seen = atomic_load_explicit(&this->tail, memory_order_acquire);
+    while (this->cap - (head - this->tail_seen) < len) {
+        sched_yield();
+        this->tail_seen = atomic_load_explicit(&this->tail,
+            memory_order_acquire);
+    }
+    memcpy(this->buf + off, data, first);
+    memcpy(this->buf, (const unsigned char *) data + first, len - first);
+    atomic_store_explicit(&this->head, head + len, memory_order_release);
+}
+
+bool offer_ring(Ring *this, const void *data, size_t len) {
+    size_t head = atomic_load_explicit(&this->head, memory_order_relaxed);
+
+    if (this->cap - (head - this->tail_seen) < len) {
+        this->tail_seen = atomic_load_explicit(&this->tail,
+            memory_order_acquire);
+        if (this->cap - (head - this->tail_seen) < len) return false;
+    }
+    push_ring(this, data, len);
+    return true;
+}
+
+void close_ring(Ring *this, Err *err) {
+    atomic_store(&this->done, true);
+    pthread_join(this->thr, NULL);
+    if (fclose(this->fp) != 0 && !is_err(&this->err)) {
+        this->err.code = ERR_IO;
+        strcpy(this->err.msg, "Could not close file");
+    }
+    free(this->rec);
+    free(this->buf);
+    if (is_err(&this->err)) {
+        *err = this->err;
+    }
+}
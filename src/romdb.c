@@ -0,0 +1,261 @@
+// Copyright (C) 2024  KA Wright
+
+// romdb.c - Per-ROM settings keyed by content hash
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "hash.h"
+#include "ram.h"
+#include "romdb.h"
+#include "vm.h"
+
+#define MAX_ROM_DB_LINE_LEN     256
+#define TUNE_KEY_FRAMES         6       // Frames each scripted key is held
+
+void init_rom_db(RomDb *this) {
+    this->len = 0;
+}
+
+bool get_rom_db_path(char *buf, size_t len) {
+    const char *home = getenv("HOME");
+
+    if (home == NULL || *home == '\0') return false;
+    return (size_t) snprintf(buf, len, "%s/%s", home, ROM_DB_FILE) < len;
+}
+
+// Parse one key=value setting into an entry. Return data indicates if the
+// setting is known and well formed.
+static bool _parse_set(RomEnt *ent, char *tok) {
+    char            *val        = strchr(tok, '=');
+    char            *end;
+    unsigned long   freq;
+
+    if (val == NULL) return false;
+    *val++ = '\0';
+    if (strcmp(tok, "name") == 0) {
+        if (strlen(val) >= MAX_ROM_NAME_LEN) return false;
+        strcpy(ent->name, val);
+        return true;
+    }
+    if (strcmp(tok, "freq") == 0) {
+        freq = strtoul(val, &end, 10);
+        if (*end != '\0' || freq == 0 || freq > UINT16_MAX) return false;
+        ent->clk_freq = (uint16_t) freq;
+        ent->has |= ROM_HAS_FREQ;
+        return true;
+    }
+    if (strcmp(tok, "quirks") == 0) {
+        ent->has |= ROM_HAS_QUIRKS;
+        return get_quirk_prof(val, &ent->quirks);
+    }
+    if (strcmp(tok, "keymap") == 0) {
+        if (strlen(val) != ROM_KEYMAP_LEN) return false;
+        strcpy(ent->keymap, val);
+        ent->has |= ROM_HAS_KEYMAP;
+        return true;
+    }
+    if (strcmp(tok, "bg") == 0 || strcmp(tok, "fg") == 0) {
+        if (tok[0] == 'b') {
+            ent->bg = (uint32_t) strtoul(val, &end, 16);
+            ent->has |= ROM_HAS_BG;
+        } else {
+            ent->fg = (uint32_t) strtoul(val, &end, 16);
+            ent->has |= ROM_HAS_FG;
+        }
+        return *end == '\0';
+    }
+    return false;
+}
+
+void ld_rom_db(RomDb *this, const char *fname, bool must_exist, Err *err) {
+    char        line[MAX_ROM_DB_LINE_LEN];
+    char        *tok;
+    char        *end;
+    RomEnt      *ent;
+    uint32_t    line_num    = 0;
+    FILE        *fp         = fopen(fname, "r");
+
+    init_rom_db(this);
+    if (fp == NULL) {
+        if (errno == ENOENT && !must_exist) return;
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_num++;
+        tok = strtok(line, " \t\r\n");
+        if (tok == NULL || tok[0] == '#') continue;
+
+        ent = add_rom_ent(this, strtoull(tok, &end, 16), err);
+        if (is_err(err)) break;
+        if (*end != '\0') {
+            err->code = ERR_DATA;
+            break;
+        }
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            if (!_parse_set(ent, tok)) {
+                err->code = ERR_DATA;
+                break;
+            }
+        }
+        if (is_err(err)) break;
+    }
+    fclose(fp);
+    if (err->code == ERR_DATA) {
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Bad entry in %s at line %u",
+            fname, line_num);
+    }
+}
+
+void sv_rom_db(const RomDb *this, const char *fname, Err *err) {
+    const RomEnt    *ent;
+    char            tmp[MAX_ROM_DB_LINE_LEN];
+    FILE            *fp;
+    bool            bad;
+
+    // Write alongside and rename, so a failed save leaves the old file
+    if ((size_t) snprintf(tmp, sizeof(tmp), "%s.tmp", fname) >= sizeof(tmp)) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Path %s too long", fname);
+        return;
+    }
+    fp = fopen(tmp, "w");
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s",
+            fname);
+        return;
+    }
+    fprintf(fp, "# k8e ROM database: HASH [name=] [freq=] [quirks=] "
+        "[keymap=] [bg=] [fg=]\n");
+    for (uint32_t i = 0; i < this->len; i++) {
+        ent = &this->ents[i];
+        fprintf(fp, "%016" PRIx64, ent->hash);
+        if (ent->name[0] != '\0') fprintf(fp, " name=%s", ent->name);
+        if (ent->has & ROM_HAS_FREQ) fprintf(fp, " freq=%u", ent->clk_freq);
+        if (ent->has & ROM_HAS_QUIRKS) {
+            fprintf(fp, " quirks=%s", get_quirk_name(ent->quirks));
+        }
+        if (ent->has & ROM_HAS_KEYMAP) fprintf(fp, " keymap=%s", ent->keymap);
+        if (ent->has & ROM_HAS_BG) fprintf(fp, " bg=%06x", ent->bg);
+        if (ent->has & ROM_HAS_FG) fprintf(fp, " fg=%06x", ent->fg);
+        fprintf(fp, "\n");
+    }
+    bad = ferror(fp) != 0;
+    bad |= fclose(fp) != 0;
+    if (bad || rename(tmp, fname) != 0) {
+        remove(tmp);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not write file %s", fname);
+    }
+}
+
+RomEnt *find_rom_ent(RomDb *this, uint64_t hash) {
+    for (uint32_t i = 0; i < this->len; i++) {
+        if (this->ents[i].hash == hash) return &this->ents[i];
+    }
+    return NULL;
+}
+
+RomEnt *add_rom_ent(RomDb *this, uint64_t hash, Err *err) {
+    RomEnt *ent = find_rom_ent(this, hash);
+
+    if (ent != NULL) return ent;
+    if (this->len >= MAX_ROM_ENTS) {
+        err->code = ERR_MEM;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "ROM database is full (%d "
+            "entries)", MAX_ROM_ENTS);
+        return NULL;
+    }
+    ent = &this->ents[this->len++];
+    memset(ent, 0, sizeof(*ent));
+    ent->hash = hash;
+    return ent;
+}
+
+// Run a ROM for a number of frames at cpf cycles each, with a key script
+// that is the same on every run, and hash the picture after each frame. If
+// ref is NULL, the hashes are stored in out, with the low bit set for frames
+// that ended in a spin wait. Otherwise return data indicates if the picture
+// matched ref after every frame where ref ended in a spin wait, or after
+// every frame if it never did.
+static bool _run_tune(const Vm *base, uint32_t cpf, uint32_t frames,
+        const uint64_t *ref, bool paced, uint64_t *out, Err *err) {
+    static Vm   vm;
+    uint32_t    seed        = CPU_RNG_SEED;
+    uint16_t    keys        = 0;
+    uint64_t    hash;
+    bool        idle;
+
+    clone_vm(&vm, base);
+    for (uint32_t i = 0; i < frames; i++) {
+
+        // Every few frames, press a random key a quarter of the time
+        if (i % TUNE_KEY_FRAMES == 0) {
+            seed = seed * 1664525 + 1013904223;
+            keys = (seed >> 30) == 0 ? 1 << ((seed >> 16) & 0xf) : 0;
+        }
+        idle = run_vm_frame(&vm, keys, cpf, err);
+        if (is_err(err)) return false;
+        hash = (hash_vid(&vm.vid) & ~(uint64_t) 1) | idle;
+        if (ref == NULL) {
+            out[i] = hash;
+        } else if ((!paced || (ref[i] & 1)) && (hash | 1) != (ref[i] | 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t tune_rom(const Ram *ram, QuirkProf quirks, uint32_t frames,
+        Err *err) {
+    static Vm   base;
+    uint64_t    *ref;
+    uint32_t    lo          = 1;
+    uint32_t    hi          = TUNE_REF_CPF;
+    uint32_t    mid;
+    bool        paced       = false;
+    Err         run_err;
+
+    ref = malloc(frames * sizeof(uint64_t));
+    if (ref == NULL) {
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate calibration buffer");
+        return 0;
+    }
+    init_vm(&base);
+    base.cpu.quirks = quirks;
+    base.ram = *ram;
+    _run_tune(&base, TUNE_REF_CPF, frames, NULL, false, ref, err);
+    if (is_err(err)) {
+        free(ref);
+        return 0;
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        paced |= ref[i] & 1;
+    }
+
+    // Find the lowest rate whose frames all match, taking any error at a
+    // low rate as a mismatch
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        init_err(&run_err);
+        if (_run_tune(&base, mid, frames, ref, paced, NULL, &run_err)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    free(ref);
+    if (lo >= TUNE_REF_CPF) return 0;
+    return lo + (lo + 7) / 8;
+}
@@ -4,12 +4,14 @@
 
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "cpu.h"
 #include "err.h"
-#include "graphic.h"
 #include "ram.h"
 #include "savest.h"
+#include "vid.h"
 
 void init_sv_st(SvSt *this) {
     for (int i=0; i<4; i++) {
@@ -39,7 +41,7 @@ void init_sv_st(SvSt *this) {
     }
 }
 
-void dump_sv_st(SvSt *this, const Cpu *cpu, const Win *win, const Ram *ram) {
+void dump_sv_st(SvSt *this, const Cpu *cpu, const Vid *vid, const Ram *ram) {
     uint8_t     temp_byte;
 
     strcpy(this->head, "K8E");
@@ -63,7 +65,7 @@ void dump_sv_st(SvSt *this, const Cpu *cpu, const Win *win, const Ram *ram) {
         for (int x=0; x<8; x++) {
             temp_byte = 0;
             for (int i=7; i>=0; i--) {
-                temp_byte += win->px_map[(x*8)+i][y] ? 0x1<<i : 0;
+                temp_byte += read_vid(vid, (x*8)+i, y) ? 0x1<<i : 0;
             }
             this->vid[x][y] = temp_byte;
         }
@@ -351,9 +353,15 @@ void sv_sv_st(const SvSt *this, const char *fname, Err *err) {
     fclose(fp);
 }
 
-void apply_sv_st(const SvSt *this, Cpu *cpu, Win *win, Ram *ram, Err *err) {
+void apply_sv_st(const SvSt *this, Cpu *cpu, Vid *vid, Ram *ram, Err *err) {
     uint8_t temp_byte;
  
+    if (this->sp >= 16 || this->pc > ADDR_PROG_END) {
+        err->code = ERR_DATA;
+        strcpy(err->msg, "Savestate has out-of-range registers");
+        return;
+    }
+
     // Cpu
     for (int i=0; i<16; i++) {
         cpu->v_regs[i] = this->v_regs[i];
@@ -375,18 +383,18 @@ void apply_sv_st(const SvSt *this, Cpu *cpu, Win *win, Ram *ram, Err *err) {
     // Video
     for (int y=0; y<32; y++) {
         
-        // Draw rows bit-by-bit
+        // Expand rows bit-by-bit
+        vid->rows[y] = 0;
         for (int x=0; x<8; x++) {
             temp_byte = this->vid[x][y];
             for (int i=7; i>=0; i--) {
                 if (temp_byte & (0x1 << i)) {
-                    draw_px(win, (x*8)+i, y, err);
-                    if (is_err(err)) return;
-                    redraw_win(win);
+                    vid->rows[y] |= (uint64_t) 1 << (63 - ((x*8)+i));
                 }    
             }
         }
     }
+    vid->dirty = true;
 }
 
 
@@ -0,0 +1,245 @@
+// Copyright (C) 2024  KA Wright
+
+// sess.c - Session recording and seeking
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err.h"
+#include "sess.h"
+#include "vm.h"
+
+// Stores the header at the start of a session file. Events and keyframes
+// follow it, in host byte order.
+typedef struct __SESS_HDR__ {
+    char        magic[4];
+    uint16_t    ver;
+    uint16_t    kf_sz;
+    uint64_t    evs_len;
+    uint64_t    kfs_len;
+    uint64_t    cyc;
+} SessHdr;
+
+// Grow an array of n elements of sz bytes so it has room for one more.
+static void *_grow(void *arr, uint64_t *cap, uint64_t n, size_t sz,
+        Err *err) {
+    void *p;
+
+    if (n < *cap) return arr;
+    p = realloc(arr, (*cap == 0 ? 256 : *cap * 2) * sz);
+    if (p == NULL) {
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not grow session log");
+        return arr;
+    }
+    *cap = *cap == 0 ? 256 : *cap * 2;
+    return p;
+}
+
+static void _push_ev(Sess *this, uint8_t kind, Err *err) {
+    this->evs = _grow(this->evs, &this->evs_cap, this->evs_len,
+        sizeof(SessEv), err);
+    if (is_err(err)) return;
+    this->evs[this->evs_len].cyc = this->cyc;
+    this->evs[this->evs_len].keys = this->keys;
+    this->evs[this->evs_len].kind = kind;
+    this->evs_len++;
+}
+
+static void _push_kf(Sess *this, const Vm *vm, Err *err) {
+    SessKf *kf;
+
+    this->kfs = _grow(this->kfs, &this->kfs_cap, this->kfs_len,
+        sizeof(SessKf), err);
+    if (is_err(err)) return;
+    kf = &this->kfs[this->kfs_len];
+    kf->cyc = this->cyc;
+    kf->ev = this->evs_len;
+    kf->keys = this->keys;
+    clone_vm(&kf->vm, vm);
+
+    // Replay runs every recorded instruction, whether or not the user had
+    // paused when the keyframe was taken
+    kf->vm.cpu.paused = false;
+    kf->vm.cpu.step = false;
+    this->kfs_len++;
+}
+
+void init_sess(Sess *this, const Vm *vm, Err *err) {
+    memset(this, 0, sizeof(Sess));
+    _push_kf(this, vm, err);
+}
+
+void free_sess(Sess *this) {
+    free(this->evs);
+    free(this->kfs);
+    this->evs = NULL;
+    this->kfs = NULL;
+}
+
+void rec_sess_op(Sess *this, uint16_t keys, Err *err) {
+    if (keys != this->keys) {
+        this->keys = keys;
+        _push_ev(this, SESS_EV_KEYS, err);
+    }
+    this->cyc++;
+}
+
+void rec_sess_tick(Sess *this, const Vm *vm, Err *err) {
+    _push_ev(this, SESS_EV_TICK, err);
+    if (is_err(err)) return;
+    this->frames++;
+    if (this->frames == SESS_KF_FRAMES) {
+        this->frames = 0;
+        _push_kf(this, vm, err);
+    }
+}
+
+void seek_sess(const Sess *this, uint64_t cyc, Vm *vm, Err *err) {
+    uint64_t        lo          = 0;
+    uint64_t        hi          = this->kfs_len;
+    uint64_t        mid;
+    uint64_t        ev;
+    uint64_t        c;
+    uint16_t        keys;
+    const SessKf    *kf;
+
+    if (cyc > this->cyc) {
+        err->code = ERR_RANGE;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Session only has %llu cycles",
+            (unsigned long long) this->cyc);
+        return;
+    }
+
+    // Find the last keyframe before cyc. A keyframe is taken after the tick
+    // at its cycle, so one at cyc itself would already be past the target.
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (this->kfs[mid].cyc < cyc) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    kf = &this->kfs[lo];
+    clone_vm(vm, &kf->vm);
+    ev = kf->ev;
+    keys = kf->keys;
+
+    // Replay in the order of the main loop: events, then the instruction
+    for (c = kf->cyc; c < cyc; c++) {
+        for (; ev < this->evs_len && this->evs[ev].cyc == c; ev++) {
+            if (this->evs[ev].kind == SESS_EV_TICK) {
+                tick_vm(vm);
+            } else {
+                keys = this->evs[ev].keys;
+            }
+        }
+        do_vm_op(vm, keys, err);
+        if (is_err(err)) return;
+    }
+}
+
+void sv_sess(const Sess *this, const char *fname, Err *err) {
+    FILE    *fp     = fopen(fname, "wb");
+    SessHdr hdr;
+
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    memcpy(hdr.magic, SESS_MAGIC, sizeof(hdr.magic));
+    hdr.ver = SESS_VER;
+    hdr.kf_sz = sizeof(SessKf);
+    hdr.evs_len = this->evs_len;
+    hdr.kfs_len = this->kfs_len;
+    hdr.cyc = this->cyc;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            fwrite(this->evs, sizeof(SessEv), this->evs_len, fp) !=
+            this->evs_len ||
+            fwrite(this->kfs, sizeof(SessKf), this->kfs_len, fp) !=
+            this->kfs_len) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not write file %s", fname);
+    }
+    fclose(fp);
+}
+
+// Check that a loaded keyframe is one do_cpu_op can run from, with events
+// in range. Return data indicates if so.
+static bool _is_kf_ok(const SessKf *kf, uint64_t evs_len) {
+    const Cpu *cpu = &kf->vm.cpu;
+
+    return cpu->quirks < QUIRK_PROF_LEN && cpu->sp < 16 && kf->ev <= evs_len;
+}
+
+void ld_sess(Sess *this, const char *fname, Err *err) {
+    FILE    *fp     = fopen(fname, "rb");
+    SessHdr hdr;
+    long    sz      = -1;
+
+    memset(this, 0, sizeof(Sess));
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    if (fseek(fp, 0, SEEK_END) == 0) sz = ftell(fp);
+    rewind(fp);
+    if (sz < (long) sizeof(hdr) || fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            memcmp(hdr.magic, SESS_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.ver != SESS_VER || hdr.kf_sz != sizeof(SessKf) ||
+            hdr.kfs_len == 0) {
+        fclose(fp);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "%s is not a version %d session",
+            fname, SESS_VER);
+        return;
+    }
+
+    // Lengths beyond what the file holds are corrupt, and could overflow
+    sz -= sizeof(hdr);
+    if (hdr.kfs_len > sz / sizeof(SessKf) || hdr.evs_len > (sz -
+            hdr.kfs_len * sizeof(SessKf)) / sizeof(SessEv)) {
+        fclose(fp);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Session %s is truncated", fname);
+        return;
+    }
+    this->evs = malloc(hdr.evs_len * sizeof(SessEv) + 1);
+    this->kfs = malloc(hdr.kfs_len * sizeof(SessKf));
+    if (this->evs == NULL || this->kfs == NULL) {
+        fclose(fp);
+        free_sess(this);
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate session");
+        return;
+    }
+    if (fread(this->evs, sizeof(SessEv), hdr.evs_len, fp) != hdr.evs_len ||
+            fread(this->kfs, sizeof(SessKf), hdr.kfs_len, fp) !=
+            hdr.kfs_len) {
+        fclose(fp);
+        free_sess(this);
+        err->code = ERR_DATA;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Session %s is truncated", fname);
+        return;
+    }
+    fclose(fp);
+    for (uint64_t i = 0; i < hdr.kfs_len; i++) {
+        this->kfs[i].vm.cow = NULL;
+        if (!_is_kf_ok(&this->kfs[i], hdr.evs_len)) {
+            free_sess(this);
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Session %s has a corrupt "
+                "keyframe", fname);
+            return;
+        }
+    }
+    this->evs_len = this->evs_cap = hdr.evs_len;
+    this->kfs_len = this->kfs_cap = hdr.kfs_len;
+    this->cyc = hdr.cyc;
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2024  KA Wright
+
+// shm.c - Live state export through POSIX shared memory
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "err.h"
+#include "ram.h"
+#include "shm.h"
+#include "turbo.h"
+#include "vid.h"
+#include "vm.h"
+
+#define SHM_SNAP_TRIES          1000
+
+static uint64_t _get_micros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * (uint64_t) 1000000 + tv.tv_usec;
+}
+
+void open_shm(Shm *this, const char *name, Err *err) {
+    int fd;
+
+    this->seg = NULL;
+    if ((size_t) snprintf(this->name, sizeof(this->name), "%s", name) >=
+            sizeof(this->name) || name[0] != '/') {
+        err->code = ERR_ARGV;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Shared-memory name must start "
+            "with / and be under %zu chars", sizeof(this->name));
+        return;
+    }
+    fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open shared memory %s",
+            name);
+        return;
+    }
+    if (ftruncate(fd, sizeof(ShmSeg)) == 0) {
+        this->seg = mmap(NULL, sizeof(ShmSeg), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (this->seg == NULL || this->seg == MAP_FAILED) {
+        this->seg = NULL;
+        shm_unlink(name);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not map shared memory %s",
+            name);
+        return;
+    }
+    memset(this->seg, 0, sizeof(ShmSeg));
+    memcpy(this->seg->magic, SHM_MAGIC, sizeof(this->seg->magic));
+    this->seg->ver = SHM_VER;
+    this->seg->seg_sz = sizeof(ShmSeg);
+    this->start_us = _get_micros();
+}
+
+void pub_shm(Shm *this, const Vm *vm, const Turbo *turbo, uint64_t frames,
+        uint64_t ops) {
+    ShmSeg      *seg        = this->seg;
+    const Cpu   *cpu        = &vm->cpu;
+    uint32_t    seq         = atomic_load_explicit(&seg->seq,
+        memory_order_relaxed);
+
+    // Odd while writing; the fence keeps the stores below after it
+    atomic_store_explicit(&seg->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    seg->frames = frames;
+    seg->ops = ops;
+    seg->wall_us = _get_micros() - this->start_us;
+    seg->cpf = is_turbo_framed(turbo) ? turbo->cpf : 0;
+    seg->speed = turbo->speed;
+    seg->paused = cpu->paused;
+    seg->quirks = get_quirks(cpu->quirks);
+    memcpy(seg->v_regs, cpu->v_regs, sizeof(seg->v_regs));
+    seg->i_reg = cpu->i_reg;
+    seg->pc = cpu->pc;
+    seg->instr = cpu->instr;
+    seg->del_timer = cpu->del_timer;
+    seg->snd_timer = cpu->snd_timer;
+    memcpy(seg->stk, cpu->stk, sizeof(seg->stk));
+    seg->sp = cpu->sp;
+    memcpy(seg->rows, vm->vid.rows, sizeof(seg->rows));
+    memcpy(seg->ram, read_vm_ram(vm)->data, sizeof(seg->ram));
+
+    atomic_store_explicit(&seg->seq, seq + 2, memory_order_release);
+}
+
+bool snap_shm(const ShmSeg *seg, ShmSeg *out) {
+    uint32_t seq;
+
+    for (uint32_t i = 0; i < SHM_SNAP_TRIES; i++) {
+        seq = atomic_load_explicit(&seg->seq, memory_order_acquire);
+        if (seq & 1) continue;
+        memcpy(out, seg, sizeof(ShmSeg));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&seg->seq, memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void close_shm(Shm *this) {
+    if (this->seg == NULL) return;
+    munmap(this->seg, sizeof(ShmSeg));
+    shm_unlink(this->name);
+    this->seg = NULL;
+}
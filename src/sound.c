@@ -20,15 +20,39 @@
 void init_snd(Snd *this, uint32_t freq, bool muted) {
     this->muted = muted;
     this->freq = freq;
-    for (long i=0; i<sizeof(this->wav); i++) {
-        this->wav[i] = 0xff * sin(2 * M_PI * this->freq * i / PCM_RATE);
-    }
+    this->wav_ready = false;
     this->pcm_dev = NULL;
     this->playing = false;
 }
 
+// Fill the tone of a Snd. The wave repeats every PCM_RATE / gcd(freq,
+// PCM_RATE) samples, so one period is computed and the rest copied.
+static void _fill_wav(Snd *this) {
+    uint32_t    a           = this->freq;
+    uint32_t    b           = PCM_RATE;
+    uint32_t    t;
+    size_t      period;
+    size_t      len;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    period = a != 0 ? PCM_RATE / a : 1;
+    for (size_t i = 0; i < period; i++) {
+        this->wav[i] = 0xff * sin(2 * M_PI * this->freq * i / PCM_RATE);
+    }
+    for (len = period; len < sizeof(this->wav); len *= 2) {
+        memcpy(this->wav + len, this->wav, len < sizeof(this->wav) - len ?
+            len : sizeof(this->wav) - len);
+    }
+    this->wav_ready = true;
+}
+
 void play_snd(Snd *this, Err *err) {
     if (!this->muted && !this->playing) {
+        if (!this->wav_ready) _fill_wav(this);
         if (snd_pcm_open(&this->pcm_dev, "default", SND_PCM_STREAM_PLAYBACK,
                 SND_PCM_NONBLOCK) != 0) {
             err->code = ERR_INIT;
@@ -0,0 +1,76 @@
+// Copyright (C) 2024  KA Wright
+
+// timing.c - COSMAC VIP instruction timing
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "timing.h"
+
+#define VIP_FETCH_CYC           40      // Fetch and dispatch of every op
+#define VIP_SKIP_CYC            4       // Extra cost of a taken skip
+
+// Stores the base cost of each op, by its high nibble. Ops whose cost
+// varies are finished in get_vip_cyc.
+static const uint16_t _op_cyc[16] = {
+    10,     // 00e0 adds its clear below; 00ee
+    12,     // 1nnn
+    26,     // 2nnn
+    10,     // 3xnn
+    10,     // 4xnn
+    14,     // 5xy0
+    6,      // 6xnn
+    10,     // 7xnn
+    44,     // 8xyn, through a patched subroutine
+    14,     // 9xy0
+    12,     // annn
+    22,     // bnnn
+    36,     // cxnn
+    26,     // dxyn adds its rows below
+    14,     // ex9e, exa1
+    10      // fx07, fx15, fx18 and others below
+};
+
+uint32_t get_vip_cyc(const Cpu *cpu, uint16_t pc, uint8_t vx) {
+    uint16_t    instr       = cpu->instr;
+    uint8_t     x           = (instr >> 8) & 0xf;
+    uint32_t    cyc         = VIP_FETCH_CYC + _op_cyc[instr >> 12];
+
+    switch (instr >> 12) {
+
+        case 0x0:
+        if (instr == 0x00e0) cyc += 3068;
+        break;
+
+        case 0x3: case 0x4: case 0x5: case 0x9: case 0xe:
+        if (((cpu->pc - pc) & ADDR_PROG_END) == 4) cyc += VIP_SKIP_CYC;
+        break;
+
+        case 0xd:
+
+        // Each row of an unaligned sprite is shifted a bit at a time into
+        // two bytes, each XORed and checked for collision. Vx is taken
+        // from before the op, as dFyn leaves the collision flag in it.
+        if ((vx & 7) == 0) {
+            cyc += (instr & 0xf) * 34;
+        } else {
+            cyc += (instr & 0xf) * (58 + (vx & 7) * 4);
+        }
+        break;
+
+        case 0xf:
+        switch (instr & 0xff) {
+            case 0x1e: cyc += 6; break;
+            case 0x29: cyc += 6; break;
+
+            // Digits are counted out by repeated subtraction
+            case 0x33:
+            cyc += 70 + (vx / 100 + vx / 10 % 10 + vx % 10) * 16;
+            break;
+
+            case 0x55: case 0x65: cyc += 4 + (x + 1) * 14; break;
+        }
+        break;
+    }
+    return cyc;
+}
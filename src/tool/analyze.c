@@ -0,0 +1,182 @@
+// Copyright (C) 2024  KA Wright
+
+// analyze.c - Static ROM analyzer; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "dis.h"
+#include "err.h"
+#include "ram.h"
+
+#define ANALYZE_OPTSTR          "hjo:"
+
+// Count the addresses with every bit of flag set.
+static uint16_t _count(const Cfg *cfg, uint8_t flag) {
+    uint16_t n = 0;
+
+    for (uint16_t i = 0; i <= ADDR_PROG_END; i++) {
+        n += (cfg->flags[i] & flag) == flag;
+    }
+    return n;
+}
+
+// Print the runs of addresses with every bit of flag set as a JSON array of
+// [first, last] pairs.
+static void _print_json_runs(const Cfg *cfg, const char *key, uint8_t flag) {
+    bool        first       = true;
+    uint16_t    lo;
+
+    printf("  \"%s\": [", key);
+    for (uint16_t i = 0; i <= ADDR_PROG_END; i++) {
+        if ((cfg->flags[i] & flag) != flag) continue;
+        for (lo = i; i < ADDR_PROG_END && (cfg->flags[i + 1] & flag) == flag;
+                i++);
+        printf("%s[%u, %u]", first ? "" : ", ", lo, i);
+        first = false;
+    }
+    printf("],\n");
+}
+
+// Print a string as a JSON string literal.
+static void _print_json_str(const char *str) {
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            printf("\\%c", *str);
+        } else if ((unsigned char) *str < 0x20) {
+            printf("\\u%04x", (unsigned char) *str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+static void _print_json(const Cfg *cfg, const char *fname) {
+    const CfgBlk *blk;
+
+    printf("{\n  \"rom\": ");
+    _print_json_str(fname);
+    printf(",\n  \"hash\": \"%016" PRIx64 "\",\n", cfg->hash);
+    printf("  \"blocks\": [\n");
+    for (uint16_t i = 0; i < cfg->blks_len; i++) {
+        blk = &cfg->blks[i];
+        printf("    {\"start\": %u, \"end\": %u, \"succ\": [", blk->start,
+            blk->end);
+        for (uint8_t j = 0; j < 2 && blk->succ[j] != CFG_NO_SUCC; j++) {
+            printf("%s%u", j > 0 ? ", " : "", blk->succ[j]);
+        }
+        printf("], \"called\": %s}%s\n", cfg->flags[blk->start] &
+            CFG_CALLED ? "true" : "false", i + 1 < cfg->blks_len ? "," : "");
+    }
+    printf("  ],\n");
+    _print_json_runs(cfg, "code", CFG_CODE);
+    _print_json_runs(cfg, "data", CFG_DATA);
+    _print_json_runs(cfg, "written", CFG_WRITTEN);
+    _print_json_runs(cfg, "self_modifying", CFG_CODE | CFG_WRITTEN);
+    _print_json_runs(cfg, "computed_jumps", CFG_COMPUTED);
+    _print_json_runs(cfg, "unknown_writes", CFG_WR_ANY);
+    printf("  \"version\": %d\n}\n", CFG_VER);
+}
+
+static void _print_text(const Cfg *cfg, const Ram *ram, const char *fname) {
+    const CfgBlk    *blk;
+    char            dis[MAX_DIS_LEN];
+    uint16_t        instr;
+
+    printf("ROM             %s (%u bytes, %016" PRIx64 ")\n", fname,
+        ram->prog_len, cfg->hash);
+    printf("BLOCKS          %u\n", cfg->blks_len);
+    printf("CODE            %u instructions\n", _count(cfg, CFG_CODE));
+    printf("DATA            %u bytes\n", _count(cfg, CFG_DATA));
+    printf("WRITTEN         %u bytes\n", _count(cfg, CFG_WRITTEN));
+    printf("SELF-MODIFYING  %u addresses\n", _count(cfg, CFG_CODE |
+        CFG_WRITTEN));
+    printf("COMPUTED JUMPS  %u\n", _count(cfg, CFG_COMPUTED));
+    printf("UNKNOWN WRITES  %u\n\n", _count(cfg, CFG_WR_ANY));
+
+    for (uint16_t i = 0; i < cfg->blks_len; i++) {
+        blk = &cfg->blks[i];
+        printf("%03x-%03x", blk->start, blk->end);
+        for (uint8_t j = 0; j < 2 && blk->succ[j] != CFG_NO_SUCC; j++) {
+            printf(" %s%03x", j == 0 ? "-> " : "", blk->succ[j]);
+        }
+        printf("%s\n", cfg->flags[blk->start] & CFG_CALLED ? "  (sub)" : "");
+        for (uint16_t addr = blk->start; addr < blk->end; addr += 2) {
+            instr = (ram->data[addr] << 8) + ram->data[addr + 1];
+            dis_op(instr, dis);
+            printf("    %03x  %04x  %s%s%s%s\n", addr, instr, dis,
+                cfg->flags[addr] & CFG_WRITTEN ? "  (modified)" : "",
+                cfg->flags[addr] & CFG_COMPUTED ? "  (computed)" : "",
+                cfg->flags[addr] & CFG_WR_ANY ? "  (writes via I)" : "");
+        }
+    }
+}
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    static Cfg  cfg;
+    static Ram  ram;
+    Err         err;
+    int         curr_opt;
+    bool        json        = false;
+    char        *out        = NULL;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, ANALYZE_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'j':
+            json = true;
+            break;
+
+            case 'o':
+            out = optarg;
+            break;
+
+            case 'h':
+            printf("k8e-analyze [-j] [-o ANALYSIS] ROM\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind != argc - 1) {
+        err.code = ERR_ARGV;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "1 positional argument expected, "
+            "but %d given", argc - optind);
+        err_alert(&err);
+        return err.code;
+    }
+
+    init_ram(&ram);
+    ld_ram_char(&ram);
+    ld_ram(&ram, argv[optind], &err);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    build_cfg(&cfg, &ram);
+
+    if (json) {
+        _print_json(&cfg, argv[optind]);
+    } else {
+        _print_text(&cfg, &ram, argv[optind]);
+    }
+    if (out != NULL) {
+        sv_cfg(&cfg, out, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+    }
+    return ERR_OK;
+}
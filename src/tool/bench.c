@@ -0,0 +1,226 @@
+// Copyright (C) 2024  KA Wright
+
+// bench.c - Interpreter microbenchmarks; entry point
+
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "err.h"
+#include "lane.h"
+#include "ram.h"
+#include "vm.h"
+
+#define BENCH_OPTSTR            "c:hl:n:r:"
+#define BENCH_MAX_REPS          64
+#define TIMER_RATE              60      // Hz
+
+// Stores a synthetic instruction stream for one opcode class. Each stream is
+// loaded at ADDR_PROG_START and loops forever.
+typedef struct __BENCH_CLS__ {
+    const char  *name;
+    uint16_t    prog[16];
+} BenchCls;
+
+static const BenchCls _classes[] = {
+    {"alu",         {0x6012, 0x7103, 0x8014, 0x8125, 0x8236, 0x8307,
+                     0x840e, 0x8011, 0x8122, 0x8233, 0x1200}},
+    {"jump/call",   {0x2208, 0x1204, 0x1200, 0x0000, 0x00ee}},
+    {"skip",        {0x3000, 0x0000, 0x4001, 0x0000, 0x5010, 0x0000,
+                     0x9010, 0x0000, 0x1200}},
+    {"drw h=1",     {0xa000, 0xd011, 0x1202}},
+    {"drw h=5",     {0xa000, 0xd015, 0x1202}},
+    {"drw h=15",    {0xa000, 0xd01f, 0x1202}},
+    {"drw unalign", {0x6003, 0xa000, 0xd01f, 0x1204}},
+    {"fx33",        {0xa300, 0xf033, 0x1202}},
+    {"fx55/fx65",   {0xa300, 0xff55, 0xff65, 0x1202}},
+};
+
+static double _get_nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int _cmp_dbl(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Print the median, mean, and standard deviation of reps samples.
+static void _report(const char *name, double *samples, uint16_t reps,
+        const char *unit) {
+    double mean = 0;
+    double var = 0;
+    for (uint16_t i = 0; i < reps; i++) {
+        mean += samples[i];
+    }
+    mean /= reps;
+    for (uint16_t i = 0; i < reps; i++) {
+        var += (samples[i] - mean) * (samples[i] - mean);
+    }
+    qsort(samples, reps, sizeof(double), _cmp_dbl);
+    printf("%-24s %12.2f %12.2f %12.2f  %s\n", name, samples[reps / 2], mean,
+        sqrt(var / reps), unit);
+}
+
+static void _bench_cls(const BenchCls *cls, uint64_t n, uint16_t reps,
+        Err *err) {
+    static Vm   vm;
+    double      ns[BENCH_MAX_REPS];
+    double      start;
+
+    for (uint16_t r = 0; r < reps; r++) {
+        init_vm(&vm);
+        ld_ram_char(&vm.ram);
+        for (uint8_t i = 0; i < 16; i++) {
+            vm.ram.data[ADDR_PROG_START + i*2] = cls->prog[i] >> 8;
+            vm.ram.data[ADDR_PROG_START + i*2 + 1] = cls->prog[i] & 0xff;
+        }
+        start = _get_nanos();
+        for (uint64_t i = 0; i < n; i++) {
+            do_vm_op(&vm, 0, err);
+        }
+        ns[r] = (_get_nanos() - start) / n;
+        if (is_err(err)) return;
+    }
+    _report(cls->name, ns, reps, "ns/instr");
+}
+
+static void _bench_rom(const char *fname, uint64_t n, uint16_t reps,
+        uint16_t freq, uint32_t lanes, Err *err) {
+    static Vm   base;
+    static Vm   vm;
+    Lanes       lns;
+    uint32_t    cpf             = freq / TIMER_RATE;
+    double      ns[BENCH_MAX_REPS];
+    double      fps[BENCH_MAX_REPS];
+    double      start;
+    char        name[64];
+
+    if (cpf == 0) cpf = 1;
+    init_vm(&base);
+    ld_ram_char(&base.ram);
+    ld_ram(&base.ram, (char *) fname, err);
+    if (is_err(err)) return;
+
+    // Single machine, running every instruction as the lanes do
+    for (uint16_t r = 0; r < reps; r++) {
+        clone_vm(&vm, &base);
+        start = _get_nanos();
+        for (uint64_t i = 0; i < n; i += cpf) {
+            for (uint32_t j = 0; j < cpf; j++) {
+                do_vm_op(&vm, 0, err);
+            }
+            if (is_err(err)) return;
+            tick_vm(&vm);
+        }
+        ns[r] = (_get_nanos() - start) / n;
+        fps[r] = 1e9 / (ns[r] * cpf);
+    }
+    snprintf(name, sizeof(name), "rom %.20s", strrchr(fname, '/') != NULL ?
+        strrchr(fname, '/') + 1 : fname);
+    _report(name, ns, reps, "ns/instr");
+    _report(name, fps, reps, "frames/s");
+
+    // Single machine through run_vm_frame, which skips spin waits, so only
+    // frames/s compares with the rows above
+    for (uint16_t r = 0; r < reps; r++) {
+        clone_vm(&vm, &base);
+        start = _get_nanos();
+        for (uint64_t i = 0; i < n; i += cpf) {
+            run_vm_frame(&vm, 0, cpf, err);
+            if (is_err(err)) return;
+        }
+        fps[r] = 1e9 * ((n + cpf - 1) / cpf) / (_get_nanos() - start);
+    }
+    snprintf(name, sizeof(name), "rom %.15s skip", strrchr(fname, '/') !=
+        NULL ? strrchr(fname, '/') + 1 : fname);
+    _report(name, fps, reps, "frames/s");
+
+    // Lockstep lanes
+    if (lanes == 0) return;
+    init_lanes(&lns, lanes, err);
+    if (is_err(err)) return;
+    for (uint16_t r = 0; r < reps; r++) {
+        ld_lanes(&lns, &base);
+        start = _get_nanos();
+        for (uint64_t i = 0; i < n; i += cpf) {
+            step_lanes(&lns, cpf);
+            tick_lanes(&lns);
+        }
+        ns[r] = (_get_nanos() - start) / ((double) n * lanes);
+    }
+    snprintf(name, sizeof(name), "lanes x%u", lanes);
+    _report(name, ns, reps, "ns/instr/lane");
+    free_lanes(&lns);
+}
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    Err         err;
+    int         curr_opt;
+    uint64_t    n           = 1000000;
+    uint16_t    reps        = 10;
+    uint16_t    freq        = 500;
+    uint32_t    lanes       = 256;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, BENCH_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'c':
+            freq = (uint16_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'l':
+            lanes = (uint32_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'n':
+            n = (uint64_t) strtoll(optarg, NULL, 10);
+            break;
+
+            case 'r':
+            reps = (uint16_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'h':
+            printf("k8e-bench [-c FREQ] [-l LANES] [-n INSTRS] [-r REPS] "
+                "[ROM...]\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (reps == 0 || reps > BENCH_MAX_REPS || n == 0) {
+        err.code = ERR_ARGV;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "Repetitions must be 1-%d and "
+            "instructions nonzero", BENCH_MAX_REPS);
+        err_alert(&err);
+        return err.code;
+    }
+
+    printf("%-24s %12s %12s %12s\n", "BENCHMARK", "MEDIAN", "MEAN", "STDDEV");
+    for (size_t i = 0; i < sizeof(_classes) / sizeof(_classes[0]); i++) {
+        _bench_cls(&_classes[i], n, reps, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        _bench_rom(argv[i], n, reps, freq, lanes, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+    }
+    return ERR_OK;
+}
@@ -0,0 +1,174 @@
+// Copyright (C) 2024  KA Wright
+
+// bundle.c - Bundle builder and inspector; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bundle.h"
+#include "err.h"
+#include "hash.h"
+#include "ram.h"
+
+#define BUNDLE_OPTSTR           "hlo:v"
+
+// Stores a ROM read for a new bundle.
+typedef struct __BUNDLE_ROM__ {
+    BundleEnt   ent;
+    Ram         ram;
+} BundleRom;
+
+static int _cmp_rom(const void *a, const void *b) {
+    return strcmp(((const BundleRom *) a)->ent.name,
+        ((const BundleRom *) b)->ent.name);
+}
+
+// Write the ROM files in fnames to a new bundle.
+static void _build(const char *out, char **fnames, uint32_t n, Err *err) {
+    BundleRom   *roms       = calloc(n, sizeof(BundleRom));
+    BundleHdr   hdr         = {{0}, BUNDLE_VER, sizeof(BundleEnt), n, 0};
+    uint32_t    off         = sizeof(BundleHdr) + n * sizeof(BundleEnt);
+    const char  *name;
+    FILE        *fp;
+
+    if (roms == NULL) {
+        err->code = ERR_MEM;
+        strcpy(err->msg, "Could not allocate ROM table");
+        return;
+    }
+    for (uint32_t i = 0; i < n && !is_err(err); i++) {
+        name = strrchr(fnames[i], '/') != NULL ? strrchr(fnames[i], '/') + 1 :
+            fnames[i];
+        if (strlen(name) >= MAX_BUNDLE_NAME_LEN) {
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Name %.48s... too long",
+                name);
+            break;
+        }
+        strcpy(roms[i].ent.name, name);
+        ld_ram(&roms[i].ram, fnames[i], err);
+        roms[i].ent.len = roms[i].ram.prog_len;
+        roms[i].ent.hash = roms[i].ram.hash;
+    }
+    qsort(roms, n, sizeof(BundleRom), _cmp_rom);
+    for (uint32_t i = 0; i < n && !is_err(err); i++) {
+        if (i > 0 && strcmp(roms[i].ent.name, roms[i - 1].ent.name) == 0) {
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Duplicate ROM name %s",
+                roms[i].ent.name);
+        }
+        roms[i].ent.off = off;
+        off += roms[i].ent.len;
+    }
+    if (is_err(err)) {
+        free(roms);
+        return;
+    }
+
+    fp = fopen(out, "wb");
+    if (fp == NULL) {
+        free(roms);
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", out);
+        return;
+    }
+    memcpy(hdr.magic, BUNDLE_MAGIC, sizeof(hdr.magic));
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    for (uint32_t i = 0; i < n; i++) {
+        fwrite(&roms[i].ent, sizeof(BundleEnt), 1, fp);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        fwrite(roms[i].ram.data + ADDR_PROG_START, roms[i].ent.len, 1, fp);
+    }
+    if (ferror(fp)) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not write file %s", out);
+    }
+    fclose(fp);
+    free(roms);
+}
+
+// List the entries of a bundle, checking each hash if verify is set.
+static uint32_t _list(const char *fname, bool verify, Err *err) {
+    Bundle      bundle;
+    uint64_t    hash;
+    uint32_t    bad         = 0;
+
+    open_bundle(&bundle, fname, err);
+    if (is_err(err)) return 0;
+    for (uint32_t i = 0; i < bundle.len; i++) {
+        const BundleEnt *ent = &bundle.ents[i];
+        hash = hash_bytes(HASH_SEED, bundle.map + ent->off, ent->len);
+        printf("%-48s %6u %016" PRIx64 "%s\n", ent->name, ent->len,
+            ent->hash, !verify ? "" : hash == ent->hash ? "  OK" : "  BAD");
+        bad += hash != ent->hash;
+    }
+    close_bundle(&bundle);
+    return verify ? bad : 0;
+}
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    Err         err;
+    int         curr_opt;
+    char        *out        = NULL;
+    bool        list        = false;
+    bool        verify      = false;
+    uint32_t    bad         = 0;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, BUNDLE_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'l':
+            list = true;
+            break;
+
+            case 'o':
+            out = optarg;
+            break;
+
+            case 'v':
+            list = true;
+            verify = true;
+            break;
+
+            case 'h':
+            printf("k8e-bundle -o BUNDLE ROM...\n"
+                "k8e-bundle -l|-v BUNDLE\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if ((out == NULL) == !list || (list && optind != argc - 1) ||
+            optind == argc) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "Expected -o with ROMs, or -l or -v with a bundle");
+        err_alert(&err);
+        return err.code;
+    }
+
+    if (list) {
+        bad = _list(argv[optind], verify, &err);
+    } else {
+        _build(out, argv + optind, argc - optind, &err);
+    }
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    if (bad > 0) {
+        err.code = ERR_DATA;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "%u entries failed their hash",
+            bad);
+        err_alert(&err);
+        return err.code;
+    }
+    return ERR_OK;
+}
@@ -0,0 +1,507 @@
+// Copyright (C) 2024  KA Wright
+
+// conform.c - Headless conformance suite; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bundle.h"
+#include "err.h"
+#include "gym.h"
+#include "hash.h"
+#include "lane.h"
+#include "ram.h"
+#include "sess.h"
+#include "vm.h"
+
+#define CONFORM_OPTSTR          "b:c:hj:w"
+#define MAX_CASES               256
+#define MAX_PATH_LEN            256
+#define MAX_LINE_LEN            512
+#define TIMER_RATE              60      // Hz
+#define GYM_CHECK_VMS           8
+#define GYM_CHECK_STEPS         6
+#define GYM_CHECK_FRAMES        3
+#define SESS_CHECK_FRAMES       150     // Spans a few keyframes
+#define LANE_CHECK_LANES        37      // Not a whole number of blocks
+#define LANE_CHECK_FRAMES       120
+
+// Stores a program for the self-checks. It counts in V1, by 5 while key 0 is
+// down and 1 otherwise, writes the count as BCD to 300 and draws its low
+// digit at x = V1, so machines holding different keys score and draw apart.
+// Each pass it round-trips V0 to V3 through RAM in a subroutine, and once
+// the delay timer set on the last move has run out, moves down by a random
+// step and clears the screen unless the key of that step is down.
+static const uint16_t _check_prog[] = {
+    0x6000,     // 200  LD V0, 0
+    0x7101,     // 202  ADD V1, 1
+    0xe0a1,     // 204  SKNP V0
+    0x7104,     // 206  ADD V1, 4
+    0xa300,     // 208  LD I, 300
+    0xf133,     // 20a  LD B, V1
+    0x2230,     // 20c  CALL 230
+    0xf129,     // 20e  LD F, V1
+    0xd135,     // 210  DRW V1, V3, 5
+    0xf207,     // 212  LD V2, DT
+    0x3200,     // 214  SE V2, 0
+    0x1202,     // 216  JP 202
+    0x6203,     // 218  LD V2, 3
+    0xf215,     // 21a  LD DT, V2
+    0xc40f,     // 21c  RND V4, 0f
+    0x8344,     // 21e  ADD V3, V4
+    0xe49e,     // 220  SKP V4
+    0x00e0,     // 222  CLS
+    0x1202,     // 224  JP 202
+    0, 0, 0, 0, 0,
+    0xa310,     // 230  LD I, 310
+    0xf355,     // 232  LD [I], V3
+    0xf365,     // 234  LD V3, [I]
+    0x00ee      // 236  RET
+};
+
+// Stores a self-check of an API that no ROM case covers.
+typedef struct __CONFORM_CHECK__ {
+    const char  *name;
+    bool        (*run)(uint32_t cpf, Err *err);
+} ConformCheck;
+
+// Stores one line of a golden manifest and the result of running it.
+typedef struct __CONFORM_CASE__ {
+    char        name[MAX_PATH_LEN];
+    char        rom[MAX_PATH_LEN * 2];
+    uint32_t    frames;
+    uint64_t    vid_hash;
+    uint64_t    cpu_hash;
+    bool        has_cpu;
+    uint64_t    got_vid;
+    uint64_t    got_cpu;
+    bool        skip_ok;                // Idle skipping left the result as is
+    Err         err;
+    bool        done;
+} ConformCase;
+
+// Parse a manifest. Each non-comment line holds a ROM path relative to the
+// manifest, a frame count, a framebuffer hash and an optional register hash.
+static uint16_t _ld_manifest(const char *fname, ConformCase *cases,
+        Err *err) {
+    FILE        *fp             = fopen(fname, "r");
+    char        line[MAX_LINE_LEN];
+    char        dir[MAX_PATH_LEN];
+    char        cpu[32];
+    uint16_t    n               = 0;
+    int         fields;
+
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return 0;
+    }
+    snprintf(dir, sizeof(dir), "%s", fname);
+    dirname(dir);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+        if (n == MAX_CASES) {
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "More than %d cases in %s",
+                MAX_CASES, fname);
+            break;
+        }
+        fields = sscanf(line, "%255s %" SCNu32 " %" SCNx64 " %31s",
+            cases[n].name, &cases[n].frames, &cases[n].vid_hash, cpu);
+        if (fields < 2) {
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "Bad line in %s: %.64s",
+                fname, line);
+            break;
+        }
+        snprintf(cases[n].rom, sizeof(cases[n].rom), "%s/%s", dir,
+            cases[n].name);
+        cases[n].has_cpu = fields == 4 && strcmp(cpu, "-") != 0;
+        if (cases[n].has_cpu) {
+            cases[n].cpu_hash = strtoull(cpu, NULL, 16);
+        }
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+// Rewrite a manifest with the hashes just measured.
+static void _dump_manifest(const char *fname, const ConformCase *cases,
+        uint16_t n, Err *err) {
+    FILE *fp = fopen(fname, "w");
+
+    if (fp == NULL) {
+        err->code = ERR_IO;
+        snprintf(err->msg, MAX_ERR_MSG_LEN, "Could not open file %s", fname);
+        return;
+    }
+    fprintf(fp, "# k8e conformance goldens: ROM FRAMES VID_HASH [CPU_HASH]\n");
+    for (uint16_t i = 0; i < n; i++) {
+        fprintf(fp, "%s %" PRIu32 " %016" PRIx64 " %016" PRIx64 "\n",
+            cases[i].name, cases[i].frames, cases[i].got_vid,
+            cases[i].got_cpu);
+    }
+    fclose(fp);
+}
+
+// Run a single case headless, with no keys down. If bundle is not NULL, the
+// ROM is looked up in it by file name rather than read from disk. The case
+// is run again stepping every instruction, without the idle skipping of
+// run_vm_frame, which must not change the result.
+static void _run_case(ConformCase *this, const Bundle *bundle, uint32_t cpf) {
+    static Vm   vm;
+    static Vm   slow;
+    const char  *base       = strrchr(this->name, '/');
+    int64_t     idx;
+
+    init_err(&this->err);
+    init_vm(&vm);
+    ld_ram_char(&vm.ram);
+    if (bundle == NULL) {
+        ld_ram(&vm.ram, this->rom, &this->err);
+    } else if ((idx = find_bundle(bundle, base != NULL ? base + 1 :
+            this->name)) < 0) {
+        this->err.code = ERR_IO;
+        strcpy(this->err.msg, "Not in bundle");
+    } else {
+        ld_ram_bundle(&vm.ram, bundle, idx, &this->err);
+    }
+    clone_vm(&slow, &vm);
+    for (uint32_t i = 0; i < this->frames && !is_err(&this->err); i++) {
+        run_vm_frame(&vm, 0, cpf, &this->err);
+    }
+    for (uint32_t i = 0; i < this->frames && !is_err(&this->err); i++) {
+        for (uint32_t j = 0; j < cpf && !is_err(&this->err); j++) {
+            do_vm_op(&slow, 0, &this->err);
+        }
+        tick_vm(&slow);
+    }
+    this->got_vid = hash_vid(&vm.vid);
+    this->got_cpu = hash_cpu(&vm.cpu);
+    this->skip_ok = this->got_vid == hash_vid(&slow.vid) &&
+        this->got_cpu == hash_cpu(&slow.cpu);
+    this->done = true;
+}
+
+// Run every case, with up to jobs child processes at once. Results are
+// written straight into cases, which must be shared with the children.
+static void _run_cases(ConformCase *cases, uint16_t n, const Bundle *bundle,
+        uint32_t cpf, uint16_t jobs) {
+    uint16_t    running         = 0;
+    pid_t       pid;
+
+    for (uint16_t i = 0; i < n; i++) {
+        if (running == jobs) {
+            wait(NULL);
+            running--;
+        }
+        pid = fork();
+        if (pid == 0) {
+            _run_case(&cases[i], bundle, cpf);
+            _exit(0);
+        }
+        if (pid < 0) {
+            _run_case(&cases[i], bundle, cpf);
+            continue;
+        }
+        running++;
+    }
+    while (running > 0) {
+        wait(NULL);
+        running--;
+    }
+}
+
+// Load the self-check program into a fresh Vm.
+static void _ld_check_prog(Vm *vm) {
+    init_vm(vm);
+    ld_ram_char(&vm->ram);
+    for (uint8_t i = 0; i < sizeof(_check_prog) / sizeof(uint16_t); i++) {
+        vm->ram.data[ADDR_PROG_START + i*2] = _check_prog[i] >> 8;
+        vm->ram.data[ADDR_PROG_START + i*2 + 1] = _check_prog[i] & 0xff;
+    }
+}
+
+// Check that step_vms over clones of one machine matches step_vm on each in
+// turn, in observations and rewards. Return data indicates if they match.
+static bool _check_gym(uint32_t cpf, Err *err) {
+    static Vm   base;
+    static Vm   batch[GYM_CHECK_VMS];
+    static Vm   single[GYM_CHECK_VMS];
+    uint64_t    obs[GYM_CHECK_VMS * GYM_OBS_WORDS];
+    uint64_t    one_obs[GYM_OBS_WORDS];
+    int64_t     rews[GYM_CHECK_VMS];
+    uint16_t    keys[GYM_CHECK_VMS];
+    int64_t     rew;
+    Gym         gym;
+    Err         one_err;
+
+    _ld_check_prog(&base);
+
+    // The BCD count, less the raw bytes of its first two digits
+    init_gym(&gym, cpf);
+    add_gym_term(&gym, 0x300, 3, true, 10);
+    add_gym_term(&gym, 0x300, 2, false, -1);
+    for (uint32_t i = 0; i < GYM_CHECK_VMS; i++) {
+        clone_vm(&batch[i], &base);
+        clone_vm(&single[i], &base);
+        keys[i] = (i & 1) | (i << 4);
+    }
+    for (uint32_t s = 0; s < GYM_CHECK_STEPS; s++) {
+        step_vms(batch, GYM_CHECK_VMS, &gym, keys, GYM_CHECK_FRAMES, obs,
+            rews, err);
+        if (is_err(err)) return false;
+        for (uint32_t i = 0; i < GYM_CHECK_VMS; i++) {
+            init_err(&one_err);
+            rew = step_vm(&single[i], &gym, keys[i], GYM_CHECK_FRAMES,
+                one_obs, &one_err);
+            if (is_err(&one_err)) {
+                *err = one_err;
+                return false;
+            }
+            if (rew != rews[i] || rew == 0 || memcmp(one_obs, obs +
+                    (size_t) i * GYM_OBS_WORDS, sizeof(one_obs)) != 0) {
+                err->code = ERR_DATA;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "step %u, machine %u: "
+                    "reward %" PRId64 ", alone %" PRId64 ", or picture "
+                    "differs", s, i, rews[i], rew);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Check that seeking a recorded session lands on the live machine, for
+// every frame of a run that starts paused, as -p and -l leave it, and
+// changes keys as it goes. Return data indicates if they match.
+static bool _check_sess(uint32_t cpf, Err *err) {
+    static Vm   live;
+    static Vm   seek;
+    Sess        sess;
+    uint16_t    keys        = 0;
+    bool        ok          = true;
+
+    _ld_check_prog(&live);
+    live.cpu.paused = true;
+    init_sess(&sess, &live, err);
+    live.cpu.paused = false;
+    for (uint32_t f = 0; f < SESS_CHECK_FRAMES && ok && !is_err(err); f++) {
+        if (f % 7 == 0) keys ^= 1;
+        for (uint32_t i = 0; i < cpf && !is_err(err); i++) {
+            rec_sess_op(&sess, keys, err);
+            do_vm_op(&live, keys, err);
+        }
+
+        // A seek lands after the instructions of a cycle but before its tick
+        if (!is_err(err)) seek_sess(&sess, sess.cyc, &seek, err);
+        if (!is_err(err) && (hash_vid(&seek.vid) != hash_vid(&live.vid) ||
+                hash_cpu(&seek.cpu) != hash_cpu(&live.cpu))) {
+            err->code = ERR_DATA;
+            snprintf(err->msg, MAX_ERR_MSG_LEN, "frame %u: seek to cycle %"
+                PRIu64 " differs from the live machine", f, sess.cyc);
+            ok = false;
+        }
+        tick_vm(&live);
+        if (!is_err(err)) rec_sess_tick(&sess, &live, err);
+    }
+    free_sess(&sess);
+    return ok && !is_err(err);
+}
+
+// Check that lockstep lanes holding different keys match do_cpu_op run on
+// each machine alone, in registers, RAM and picture, every frame. Keys start
+// the same, so lanes share a pc, then split and rejoin in changing groups.
+// Return data indicates if they match.
+static bool _check_lanes(uint32_t cpf, Err *err) {
+    static Vm   base;
+    static Vm   vms[LANE_CHECK_LANES];
+    Lanes       lns;
+    Cpu         cpu;
+    uint16_t    keys;
+    bool        ok          = true;
+
+    _ld_check_prog(&base);
+    init_lanes(&lns, LANE_CHECK_LANES, err);
+    if (is_err(err)) return false;
+    ld_lanes(&lns, &base);
+    for (uint32_t i = 0; i < LANE_CHECK_LANES; i++) {
+        clone_vm(&vms[i], &base);
+        own_vm_ram(&vms[i]);
+    }
+    for (uint32_t f = 0; f < LANE_CHECK_FRAMES && ok; f++) {
+        for (uint32_t i = 0; i < LANE_CHECK_LANES && !is_err(err); i++) {
+            keys = f < 20 || (i + f / 20) % 4 == 0 ? 0 : 1u << ((i + f / 20) %
+                16);
+            lns.keys[i] = keys;
+            for (uint32_t j = 0; j < cpf && !is_err(err); j++) {
+                do_cpu_op(&vms[i].cpu, &vms[i].ram, &vms[i].vid, keys, err);
+            }
+            tick_vm(&vms[i]);
+        }
+        if (is_err(err)) break;
+        step_lanes(&lns, cpf);
+        tick_lanes(&lns);
+        for (uint32_t i = 0; i < LANE_CHECK_LANES && ok; i++) {
+            dump_lane(&lns, i, &cpu);
+            if (lns.halted[i] != ERR_OK || hash_cpu(&cpu) !=
+                    hash_cpu(&vms[i].cpu) || cpu.rng != vms[i].cpu.rng ||
+                    memcmp(lns.ram[i].data, read_vm_ram(&vms[i])->data,
+                    sizeof(lns.ram[i].data)) != 0 || memcmp(lns.vid[i].rows,
+                    vms[i].vid.rows, sizeof(vms[i].vid.rows)) != 0) {
+                err->code = ERR_DATA;
+                snprintf(err->msg, MAX_ERR_MSG_LEN, "frame %u: lane %u "
+                    "differs from do_cpu_op", f, i);
+                ok = false;
+            }
+        }
+    }
+    free_lanes(&lns);
+    return ok && !is_err(err);
+}
+
+static const ConformCheck _checks[] = {
+    {"step_vms",    _check_gym},
+    {"seek_sess",   _check_sess},
+    {"lanes",       _check_lanes}
+};
+#define CHECKS_LEN      (sizeof(_checks) / sizeof(ConformCheck))
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    Err         err;
+    ConformCase *cases;
+    Bundle      bundle;
+    Bundle      *bundle_ptr = NULL;
+    int         curr_opt;
+    uint16_t    n;
+    uint16_t    failed      = 0;
+    uint16_t    freq        = 500;
+    uint16_t    jobs        = sysconf(_SC_NPROCESSORS_ONLN);
+    bool        write       = false;
+    const char  *fname;
+    const char  *bundle_fn  = NULL;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, CONFORM_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'b':
+            bundle_fn = optarg;
+            break;
+
+            case 'c':
+            freq = (uint16_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'j':
+            jobs = (uint16_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'w':
+            write = true;
+            break;
+
+            case 'h':
+            printf("k8e-conform [-b BUNDLE] [-c FREQ] [-j JOBS] [-w] "
+                "MANIFEST\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind != argc - 1 || freq < TIMER_RATE) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "Expected one manifest and a frequency of 60 or more");
+        err_alert(&err);
+        return err.code;
+    }
+    fname = argv[optind];
+    if (jobs == 0) jobs = 1;
+
+    cases = mmap(NULL, MAX_CASES * sizeof(ConformCase), PROT_READ |
+        PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (cases == MAP_FAILED) {
+        err.code = ERR_MEM;
+        strcpy(err.msg, "Could not map shared memory");
+        err_alert(&err);
+        return err.code;
+    }
+    n = _ld_manifest(fname, cases, &err);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+
+    // Map the bundle before forking so every worker shares its pages
+    if (bundle_fn != NULL) {
+        open_bundle(&bundle, bundle_fn, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+        bundle_ptr = &bundle;
+    }
+    _run_cases(cases, n, bundle_ptr, freq / TIMER_RATE, jobs);
+    if (bundle_ptr != NULL) close_bundle(bundle_ptr);
+
+    for (uint16_t i = 0; i < n; i++) {
+        ConformCase *c = &cases[i];
+        if (!c->done) {
+            c->err.code = ERR_GEN;
+            strcpy(c->err.msg, "Worker did not finish");
+        }
+        if (is_err(&c->err)) {
+            printf("FAIL  %s: %s\n", c->rom, c->err.msg);
+            failed++;
+        } else if (!c->skip_ok) {
+            printf("FAIL  %s: idle skipping changed the result\n", c->rom);
+            failed++;
+        } else if (write) {
+            printf("SAVE  %s\n", c->rom);
+        } else if (c->got_vid != c->vid_hash) {
+            printf("FAIL  %s: framebuffer %016" PRIx64 ", expected %016"
+                PRIx64 "\n", c->rom, c->got_vid, c->vid_hash);
+            failed++;
+        } else if (c->has_cpu && c->got_cpu != c->cpu_hash) {
+            printf("FAIL  %s: registers %016" PRIx64 ", expected %016"
+                PRIx64 "\n", c->rom, c->got_cpu, c->cpu_hash);
+            failed++;
+        } else {
+            printf("PASS  %s\n", c->rom);
+        }
+    }
+    for (uint16_t i = 0; i < CHECKS_LEN; i++) {
+        init_err(&err);
+        if (_checks[i].run(freq / TIMER_RATE, &err)) {
+            printf("PASS  %s\n", _checks[i].name);
+        } else {
+            printf("FAIL  %s: %s\n", _checks[i].name, err.msg);
+            failed++;
+        }
+    }
+    init_err(&err);
+    printf("%u/%u passed\n", n + (uint16_t) CHECKS_LEN - failed,
+        n + (uint16_t) CHECKS_LEN);
+
+    if (write && failed == 0) {
+        _dump_manifest(fname, cases, n, &err);
+    }
+    munmap(cases, MAX_CASES * sizeof(ConformCase));
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    return failed == 0 ? ERR_OK : ERR_DATA;
+}
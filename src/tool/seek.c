@@ -0,0 +1,100 @@
+// Copyright (C) 2024  KA Wright
+
+// seek.c - Session seek; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "err.h"
+#include "hash.h"
+#include "savest.h"
+#include "sess.h"
+#include "vm.h"
+
+#define SEEK_OPTSTR             "ho:"
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    static SvSt sv_st;
+    static Vm   vm;
+    Err         err;
+    Sess        sess;
+    int         curr_opt;
+    uint64_t    cyc;
+    char        *out        = NULL;
+    struct timespec start;
+    struct timespec end;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, SEEK_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'o':
+            out = optarg;
+            break;
+
+            case 'h':
+            printf("k8e-seek [-o SAVESTATE] SESSION [CYCLE]\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind != argc - 1 && optind != argc - 2) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "Expected a session and an optional cycle");
+        err_alert(&err);
+        return err.code;
+    }
+
+    ld_sess(&sess, argv[optind], &err);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    if (optind == argc - 1) {
+        printf("CYCLES     %" PRIu64 "\nEVENTS     %" PRIu64 "\n"
+            "KEYFRAMES  %" PRIu64 "\n", sess.cyc, sess.evs_len, sess.kfs_len);
+        free_sess(&sess);
+        return ERR_OK;
+    }
+    cyc = strtoull(argv[optind + 1], NULL, 10);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    seek_sess(&sess, cyc, &vm, &err);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free_sess(&sess);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+
+    printf("CYCLE %" PRIu64 "  PC:%03x  I:%03x  V:", cyc, vm.cpu.pc,
+        vm.cpu.i_reg);
+    for (uint8_t i = 0; i < 16; i++) {
+        printf("%02x%s", vm.cpu.v_regs[i], i < 15 ? " " : "");
+    }
+    printf("  D:%02x  S:%02x  SP:%02x\n", vm.cpu.del_timer, vm.cpu.snd_timer,
+        vm.cpu.sp);
+    printf("VID %016" PRIx64 "  CPU %016" PRIx64 "  (%.3f ms)\n",
+        hash_vid(&vm.vid), hash_cpu(&vm.cpu), (end.tv_sec - start.tv_sec) *
+        1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    if (out != NULL) {
+        own_vm_ram(&vm);
+        init_sv_st(&sv_st);
+        dump_sv_st(&sv_st, &vm.cpu, &vm.vid, &vm.ram);
+        sv_sv_st(&sv_st, out, &err);
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+    }
+    return ERR_OK;
+}
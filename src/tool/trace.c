@@ -0,0 +1,178 @@
+// Copyright (C) 2024  KA Wright
+
+// trace.c - Binary trace decoder and search; entry point
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dis.h"
+#include "err.h"
+#include "trace.h"
+
+#define TRACE_OPTSTR            "cf:hn:o:p:r:"
+#define TRACE_BATCH             4096        // Records read at once
+
+// Stores the record filter built from the command line.
+typedef struct __TRACE_FILTER__ {
+    uint32_t    frame_lo;
+    uint32_t    frame_hi;
+    uint16_t    pc_lo;
+    uint16_t    pc_hi;
+    uint16_t    op;
+    uint16_t    op_mask;
+    uint16_t    v_chg;
+} TraceFilter;
+
+// Parse LO or LO-HI in the given base.
+static void _parse_range(const char *arg, int base, uint32_t *lo,
+        uint32_t *hi) {
+    char *end;
+
+    *lo = (uint32_t) strtoul(arg, &end, base);
+    *hi = *end == '-' ? (uint32_t) strtoul(end + 1, NULL, base) : *lo;
+}
+
+// Get a bitmask of the registers which differ between two register files.
+static uint16_t _diff_regs(const uint8_t *prev, const uint8_t *curr) {
+    uint16_t chg = 0;
+
+    for (uint8_t i = 0; i < 16; i++) {
+        chg |= (uint16_t) (prev[i] != curr[i]) << i;
+    }
+    return chg;
+}
+
+static bool _match(const TraceFilter *this, const TraceRec *rec,
+        uint16_t v_chg) {
+    return rec->frame >= this->frame_lo && rec->frame <= this->frame_hi &&
+        rec->pc >= this->pc_lo && rec->pc <= this->pc_hi &&
+        (rec->instr & this->op_mask) == this->op &&
+        (this->v_chg == 0 || (v_chg & this->v_chg) != 0);
+}
+
+static void _print_rec(const TraceRec *rec, uint16_t v_chg) {
+    char dis[MAX_DIS_LEN];
+
+    dis_op(rec->instr, dis);
+    printf("%8u  %03x  %04x  %-16s I:%03x  D:%02x  S:%02x  SP:%x ",
+        rec->frame, rec->pc, rec->instr, dis, rec->i_reg, rec->del_timer,
+        rec->snd_timer, rec->sp);
+    for (uint8_t i = 0; i < 16; i++) {
+        if ((v_chg >> i) & 1) {
+            printf(" V%X=%02x", i, rec->v_regs[i]);
+        }
+    }
+    printf("\n");
+}
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    static TraceRec recs[TRACE_BATCH];
+    Err         err;
+    TraceFilter filter      = {0, UINT32_MAX, 0, 0xfff, 0, 0, 0};
+    TraceHdr    hdr;
+    FILE        *fp;
+    int         curr_opt;
+    uint32_t    lo;
+    uint32_t    hi;
+    uint64_t    limit       = UINT64_MAX;
+    uint64_t    total       = 0;
+    uint64_t    found       = 0;
+    size_t      n;
+    uint8_t     v_prev[16];
+    uint16_t    v_chg;
+    bool        count       = false;
+    char        *end;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, TRACE_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'c':
+            count = true;
+            break;
+
+            case 'f':
+            _parse_range(optarg, 10, &filter.frame_lo, &filter.frame_hi);
+            break;
+
+            case 'n':
+            limit = strtoull(optarg, NULL, 10);
+            break;
+
+            case 'o':
+            filter.op = (uint16_t) strtoul(optarg, &end, 16);
+            filter.op_mask = *end == '/' ?
+                (uint16_t) strtoul(end + 1, NULL, 16) : 0xffff;
+            filter.op &= filter.op_mask;
+            break;
+
+            case 'p':
+            _parse_range(optarg, 16, &lo, &hi);
+            filter.pc_lo = lo;
+            filter.pc_hi = hi;
+            break;
+
+            case 'r':
+            filter.v_chg |= 1 << (strtoul(optarg, NULL, 16) & 0xf);
+            break;
+
+            case 'h':
+            printf("k8e-trace [-c] [-f FRAME[-FRAME]] [-n COUNT] "
+                "[-o OP[/MASK]] [-p ADDR[-ADDR]] [-r REG] FILE\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind != argc - 1) {
+        err.code = ERR_ARGV;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "1 positional argument expected, "
+            "but %d given", argc - optind);
+        err_alert(&err);
+        return err.code;
+    }
+
+    fp = fopen(argv[optind], "rb");
+    if (fp == NULL) {
+        err.code = ERR_IO;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "Could not open file %s",
+            argv[optind]);
+        err_alert(&err);
+        return err.code;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.ver != TRACE_VER || hdr.rec_sz != sizeof(TraceRec)) {
+        fclose(fp);
+        err.code = ERR_DATA;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "%s is not a version %d trace",
+            argv[optind], TRACE_VER);
+        err_alert(&err);
+        return err.code;
+    }
+    memcpy(v_prev, hdr.v_regs, sizeof(v_prev));
+
+    while (found < limit &&
+            (n = fread(recs, sizeof(TraceRec), TRACE_BATCH, fp)) > 0) {
+        for (size_t i = 0; i < n && found < limit; i++) {
+            v_chg = _diff_regs(v_prev, recs[i].v_regs);
+            memcpy(v_prev, recs[i].v_regs, sizeof(v_prev));
+            if (!_match(&filter, &recs[i], v_chg)) continue;
+            found++;
+            if (!count) _print_rec(&recs[i], v_chg);
+        }
+        total += n;
+    }
+    fclose(fp);
+    if (count) {
+        printf("%llu of %llu records read matched\n",
+            (unsigned long long) found, (unsigned long long) total);
+    }
+    return ERR_OK;
+}
@@ -0,0 +1,144 @@
+// Copyright (C) 2024  KA Wright
+
+// tune.c - ROM clock calibration; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+#include "romdb.h"
+
+#define TUNE_OPTSTR             "d:f:hnq:"
+#define TIMER_RATE              60      // Hz
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    static RomDb    db;
+    static Ram      ram;
+    Err             err;
+    RomEnt          *ent;
+    QuirkProf       quirks;
+    int             curr_opt;
+    uint32_t        frames      = TUNE_FRAMES;
+    uint32_t        cpf;
+    uint32_t        failed      = 0;
+    bool            dry_run     = false;
+    bool            set_quirks  = false;
+    char            db_fn[256];
+    char            *name;
+
+    init_err(&err);
+    if (!get_rom_db_path(db_fn, sizeof(db_fn))) db_fn[0] = '\0';
+    while ((curr_opt = getopt(argc, argv, TUNE_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'd':
+            snprintf(db_fn, sizeof(db_fn), "%s", optarg);
+            break;
+
+            case 'f':
+            frames = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+
+            case 'n':
+            dry_run = true;
+            break;
+
+            case 'q':
+            if (!get_quirk_prof(optarg, &quirks)) {
+                err.code = ERR_ARGV;
+                snprintf(err.msg, MAX_ERR_MSG_LEN, "Unknown quirk profile %s",
+                    optarg);
+                err_alert(&err);
+                return err.code;
+            }
+            set_quirks = true;
+            break;
+
+            case 'h':
+            printf("k8e-tune [-d DB] [-f FRAMES] [-n] [-q QUIRKS] ROM...\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind >= argc || frames == 0) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "Expected at least 1 ROM and 1 frame");
+        err_alert(&err);
+        return err.code;
+    }
+    if (db_fn[0] == '\0' && !dry_run) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "No home directory; give a database with -d");
+        err_alert(&err);
+        return err.code;
+    }
+    if (db_fn[0] != '\0') ld_rom_db(&db, db_fn, false, &err);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+
+    for (int i = optind; i < argc && !is_err(&err); i++) {
+        init_ram(&ram);
+        ld_ram_char(&ram);
+        ld_ram(&ram, argv[i], &err);
+        if (is_err(&err)) break;
+        ent = add_rom_ent(&db, ram.hash, &err);
+        if (is_err(&err)) break;
+
+        // Tune with the profile the ROM will run with
+        if (set_quirks) {
+            ent->quirks = quirks;
+            ent->has |= ROM_HAS_QUIRKS;
+        }
+        if (ent->name[0] == '\0') {
+            name = basename(argv[i]);
+            snprintf(ent->name, MAX_ROM_NAME_LEN, "%.*s", (int) strcspn(name,
+                " \t"), name);
+        }
+        cpf = tune_rom(&ram, ent->has & ROM_HAS_QUIRKS ? ent->quirks :
+            QUIRK_K8E, frames, &err);
+
+        // A ROM that fails at the reference rate is reported and skipped
+        if (is_err(&err) && err.code != ERR_MEM) {
+            printf("%016" PRIx64 "  %-24s  failed: %s\n", ram.hash, ent->name,
+                err.msg);
+            init_err(&err);
+            failed++;
+            continue;
+        }
+        if (is_err(&err)) break;
+        if (cpf == 0) {
+            printf("%016" PRIx64 "  %-24s  not timer-paced, left as is\n",
+                ram.hash, ent->name);
+            continue;
+        }
+        if (cpf > UINT16_MAX / TIMER_RATE) cpf = UINT16_MAX / TIMER_RATE;
+        ent->clk_freq = cpf * TIMER_RATE;
+        ent->has |= ROM_HAS_FREQ;
+        printf("%016" PRIx64 "  %-24s  %u cycles/frame (%u Hz)\n", ram.hash,
+            ent->name, cpf, ent->clk_freq);
+    }
+    if (!is_err(&err) && !dry_run) sv_rom_db(&db, db_fn, &err);
+    if (!is_err(&err) && failed > 0) {
+        err.code = ERR_DATA;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "%u ROMs could not be tuned",
+            failed);
+    }
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    return ERR_OK;
+}
@@ -0,0 +1,454 @@
+// Copyright (C) 2024  KA Wright
+
+// xlat.c - ROM to C translator; entry point
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "cpu.h"
+#include "dis.h"
+#include "err.h"
+#include "ram.h"
+
+#define XLAT_OPTSTR             "a:ho:q:"
+
+// Check for the delay timer spin wait that skip_vm_idle matches. Such a
+// block hands back to the runtime while the timer runs, to be skipped.
+static bool _is_idle(const Ram *ram, uint16_t addr) {
+    const uint8_t *data = ram->data;
+
+    return addr + 5 <= ADDR_PROG_END && (data[addr] & 0xf0) == 0xf0 &&
+        data[addr + 1] == 0x07 && data[addr + 2] == (0x30 | (data[addr] &
+        0xf)) && data[addr + 3] == 0x00 && data[addr + 4] == (0x10 | addr >>
+        8) && data[addr + 5] == (addr & 0xff);
+}
+
+// Check for a jump to itself, which the runtime always skips.
+static bool _is_halt(const Ram *ram, uint16_t addr) {
+    return ram->data[addr] == (0x10 | addr >> 8) && ram->data[addr + 1] ==
+        (addr & 0xff);
+}
+
+// Write a transfer of control to addr. Blocks are entered directly; any
+// other address is left to the dispatch switch through the runtime.
+static void _emit_goto(FILE *fp, const Cfg *cfg, uint16_t addr,
+        uint16_t undo) {
+    if (addr < ADDR_PROG_END && find_cfg_blk(cfg, addr) >= 0) {
+        fprintf(fp, "goto L_%03x;", addr);
+    } else {
+        fprintf(fp, "XLAT_EXIT(0x%03x, %u);", addr, undo);
+    }
+}
+
+// Write a skip, which ends its block: taken goes to addr + 4.
+static void _emit_skip(FILE *fp, const Cfg *cfg, uint16_t addr,
+        const char *cond) {
+    fprintf(fp, "    if (%s) ", cond);
+    _emit_goto(fp, cfg, addr + 4, 0);
+    fprintf(fp, "\n    ");
+    _emit_goto(fp, cfg, addr + 2, 0);
+    fprintf(fp, "\n");
+}
+
+// Write one instruction. The undo count is the instructions of the block,
+// including this one, which have not run yet. Return data indicates if the
+// instruction ended the block.
+static bool _emit_op(FILE *fp, const Cfg *cfg, uint16_t addr, uint16_t instr,
+        uint16_t undo, uint8_t quirks, bool *dispatch) {
+    uint8_t     x           = (instr >> 8) & 0xf;
+    uint8_t     y           = (instr >> 4) & 0xf;
+    uint8_t     n           = instr & 0xf;
+    uint8_t     kk          = instr & 0xff;
+    uint16_t    nnn         = instr & 0xfff;
+    char        cond[64];
+
+    switch (get_op_cls(instr)) {
+
+        case OP_CLS:
+        fprintf(fp, "    clear_vid(&vm->vid);\n");
+        return false;
+
+        case OP_RET:
+        fprintf(fp, "    if (cpu->sp == 0) XLAT_EXIT(0x%03x, %u);\n"
+            "    cpu->pc = cpu->stk[cpu->sp--] + 2;\n    goto dispatch;\n",
+            addr, undo);
+        *dispatch = true;
+        return true;
+
+        case OP_JP:
+        fprintf(fp, "    ");
+        _emit_goto(fp, cfg, nnn, 0);
+        fprintf(fp, "\n");
+        return true;
+
+        case OP_CALL:
+        fprintf(fp, "    if (cpu->sp >= 15) XLAT_EXIT(0x%03x, %u);\n"
+            "    cpu->stk[++cpu->sp] = 0x%03x;\n    ", addr, undo, addr);
+        _emit_goto(fp, cfg, nnn, 0);
+        fprintf(fp, "\n");
+        return true;
+
+        case OP_SE_BYTE:
+        snprintf(cond, sizeof(cond), "v[0x%x] == 0x%02x", x, kk);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_SNE_BYTE:
+        snprintf(cond, sizeof(cond), "v[0x%x] != 0x%02x", x, kk);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_SE_REG:
+        snprintf(cond, sizeof(cond), "v[0x%x] == v[0x%x]", x, y);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_SNE_REG:
+        snprintf(cond, sizeof(cond), "v[0x%x] != v[0x%x]", x, y);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_SKP:
+        snprintf(cond, sizeof(cond), "v[0x%x] < 16 && (keys >> v[0x%x]) & 1",
+            x, x);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_SKNP:
+        snprintf(cond, sizeof(cond), "!(v[0x%x] < 16 && (keys >> v[0x%x]) & "
+            "1)", x, x);
+        _emit_skip(fp, cfg, addr, cond);
+        return true;
+
+        case OP_LD_BYTE:
+        fprintf(fp, "    v[0x%x] = 0x%02x;\n", x, kk);
+        return false;
+
+        case OP_ADD_BYTE:
+        fprintf(fp, "    v[0x%x] += 0x%02x;\n", x, kk);
+        return false;
+
+        case OP_LD_REG:
+        fprintf(fp, "    v[0x%x] = v[0x%x];\n", x, y);
+        return false;
+
+        case OP_OR:
+        fprintf(fp, "    v[0x%x] |= v[0x%x];\n", x, y);
+        if (quirks & QUIRK_VF_RESET) fprintf(fp, "    v[0xf] = 0;\n");
+        return false;
+
+        case OP_AND:
+        fprintf(fp, "    v[0x%x] &= v[0x%x];\n", x, y);
+        if (quirks & QUIRK_VF_RESET) fprintf(fp, "    v[0xf] = 0;\n");
+        return false;
+
+        case OP_XOR:
+        fprintf(fp, "    v[0x%x] ^= v[0x%x];\n", x, y);
+        if (quirks & QUIRK_VF_RESET) fprintf(fp, "    v[0xf] = 0;\n");
+        return false;
+
+        case OP_ADD_REG:
+        fprintf(fp, "    f = v[0x%x] + v[0x%x] > 255;\n    v[0x%x] += "
+            "v[0x%x];\n    v[0xf] = f;\n", x, y, x, y);
+        return false;
+
+        case OP_SUB:
+        fprintf(fp, "    f = v[0x%x] >= v[0x%x];\n    v[0x%x] -= v[0x%x];\n"
+            "    v[0xf] = f;\n", x, y, x, y);
+        return false;
+
+        case OP_SHR:
+        if (quirks & QUIRK_SHIFT_VY) fprintf(fp, "    v[0x%x] = v[0x%x];\n",
+            x, y);
+        fprintf(fp, "    f = v[0x%x] & 1;\n    v[0x%x] >>= 1;\n"
+            "    v[0xf] = f;\n", x, x);
+        return false;
+
+        case OP_SUBN:
+        fprintf(fp, "    f = v[0x%x] >= v[0x%x];\n    v[0x%x] = v[0x%x] - "
+            "v[0x%x];\n    v[0xf] = f;\n", y, x, x, y, x);
+        return false;
+
+        case OP_SHL:
+        if (quirks & QUIRK_SHIFT_VY) fprintf(fp, "    v[0x%x] = v[0x%x];\n",
+            x, y);
+        fprintf(fp, "    f = v[0x%x] >> 7;\n    v[0x%x] <<= 1;\n"
+            "    v[0xf] = f;\n", x, x);
+        return false;
+
+        case OP_LD_I:
+        fprintf(fp, "    cpu->i_reg = 0x%03x;\n", nnn);
+        return false;
+
+        case OP_JP_V0:
+        fprintf(fp, "    cpu->pc = v[0x%x] + 0x%03x;\n    goto dispatch;\n",
+            quirks & QUIRK_JP_VX ? x : 0, nnn);
+        *dispatch = true;
+        return true;
+
+        case OP_RND:
+        fprintf(fp, "    cpu->rng ^= cpu->rng << 13;\n"
+            "    cpu->rng ^= cpu->rng >> 17;\n"
+            "    cpu->rng ^= cpu->rng << 5;\n"
+            "    v[0x%x] = ((uint8_t) cpu->rng) & 0x%02x;\n", x, kk);
+        return false;
+
+        case OP_DRW:
+        fprintf(fp, "    if (cpu->i_reg + %u > 0x%03x) XLAT_EXIT(0x%03x, %u);\n"
+            "    v[0xf] = %s(&vm->vid, v[0x%x], v[0x%x], mem + "
+            "cpu->i_reg, %u);\n", n, ADDR_PROG_END + 1, addr, undo,
+            quirks & QUIRK_CLIP ? "draw_vid_clip" : "draw_vid", x, y, n);
+        return false;
+
+        case OP_LD_DT_GET:
+        fprintf(fp, "    v[0x%x] = cpu->del_timer;\n", x);
+        return false;
+
+        case OP_LD_K:
+        fprintf(fp, "    if (keys == 0) XLAT_EXIT(0x%03x, %u);\n"
+            "    v[0x%x] = __builtin_ctz(keys);\n", addr, undo, x);
+        return false;
+
+        case OP_LD_DT_SET:
+        fprintf(fp, "    cpu->del_timer = v[0x%x];\n", x);
+        return false;
+
+        case OP_LD_ST:
+        fprintf(fp, "    cpu->snd_timer = v[0x%x];\n", x);
+        return false;
+
+        case OP_ADD_I:
+        fprintf(fp, "    cpu->i_reg += v[0x%x];\n", x);
+        return false;
+
+        case OP_LD_F:
+        fprintf(fp, "    if (v[0x%x] < 16) cpu->i_reg = v[0x%x] * %d;\n", x,
+            x, SPRITE_LEN);
+        return false;
+
+        // Writes over translated code end the block, so the next one is
+        // checked against the image before it runs
+        case OP_LD_B:
+        fprintf(fp, "    if (cpu->i_reg >= 0x%03x) XLAT_EXIT(0x%03x, %u);\n"
+            "    mem[cpu->i_reg] = v[0x%x] / 100;\n"
+            "    mem[cpu->i_reg + 1] = (v[0x%x] %% 100) / 10;\n"
+            "    mem[cpu->i_reg + 2] = v[0x%x] %% 10;\n"
+            "    if (is_xlat_code(x->prog, cpu->i_reg, 3)) {\n"
+            "        x->smc = true;\n        XLAT_EXIT(0x%03x, %u);\n"
+            "    }\n", ADDR_PROG_END - 2, addr, undo, x, x, x, addr + 2,
+            undo - 1);
+        return false;
+
+        case OP_LD_MEM_SET:
+        fprintf(fp, "    if (cpu->i_reg + %u >= 0x%03x) XLAT_EXIT(0x%03x, %u);"
+            "\n    memcpy(mem + cpu->i_reg, v, %u);\n", x, ADDR_PROG_END, addr,
+            undo, x + 1);
+        if (quirks & QUIRK_MEM_INC_I) {
+            fprintf(fp, "    cpu->i_reg += %u;\n"
+                "    if (is_xlat_code(x->prog, cpu->i_reg - %u, %u)) {\n",
+                x + 1, x + 1, x + 1);
+        } else {
+            fprintf(fp, "    if (is_xlat_code(x->prog, cpu->i_reg, %u)) {\n",
+                x + 1);
+        }
+        fprintf(fp, "        x->smc = true;\n        XLAT_EXIT(0x%03x, %u);\n"
+            "    }\n", addr + 2, undo - 1);
+        return false;
+
+        case OP_LD_MEM_GET:
+        fprintf(fp, "    if (cpu->i_reg + %u >= 0x%03x) XLAT_EXIT(0x%03x, %u);"
+            "\n    memcpy(v, mem + cpu->i_reg, %u);\n", x, ADDR_PROG_END, addr,
+            undo, x + 1);
+        if (quirks & QUIRK_MEM_INC_I) {
+            fprintf(fp, "    cpu->i_reg += %u;\n", x + 1);
+        }
+        return false;
+
+        // SYS and illegal opcodes do nothing
+        default:
+        return false;
+    }
+}
+
+// Write the whole translation of a ROM.
+static void _emit(FILE *fp, const Cfg *cfg, const Ram *ram,
+        const char *fname, QuirkProf prof) {
+    static uint64_t code_map[(ADDR_PROG_END + 1) / 64];
+    const CfgBlk    *blk;
+    uint16_t        img_end     = ADDR_PROG_START + ram->prog_len;
+    uint16_t        instr;
+    uint16_t        len;
+    bool            dispatch    = false;
+    char            dis[MAX_DIS_LEN];
+
+    memset(code_map, 0, sizeof(code_map));
+    for (uint16_t i = 0; i < cfg->blks_len; i++) {
+        blk = &cfg->blks[i];
+        for (uint16_t addr = blk->start; addr < blk->end; addr++) {
+            code_map[addr >> 6] |= (uint64_t) 1 << (addr & 63);
+        }
+        if (blk->end > img_end) img_end = blk->end;
+    }
+
+    fprintf(fp, "// Translated by k8e-xlat from %s (%016" PRIx64 ", %s "
+        "quirks)\n\n"
+        "#include <stdbool.h>\n#include <stdint.h>\n#include <string.h>\n\n"
+        "#include \"vid.h\"\n#include \"vm.h\"\n#include \"xlat.h\"\n\n",
+        fname, cfg->hash, get_quirk_name(prof));
+
+    fprintf(fp, "static const uint8_t _img[%u] = {", img_end -
+        ADDR_PROG_START);
+    for (uint16_t addr = ADDR_PROG_START; addr < img_end; addr++) {
+        fprintf(fp, "%s0x%02x,", (addr - ADDR_PROG_START) % 12 == 0 ?
+            "\n    " : " ", ram->data[addr]);
+    }
+    fprintf(fp, "\n};\n\nstatic const uint64_t _code_map[%u] = {",
+        (ADDR_PROG_END + 1) / 64);
+    for (uint16_t i = 0; i < (ADDR_PROG_END + 1) / 64; i++) {
+        fprintf(fp, "%s0x%016" PRIx64 ",", i % 3 == 0 ? "\n    " : " ",
+            code_map[i]);
+    }
+    fprintf(fp, "\n};\n\n");
+
+    fprintf(fp, "static uint32_t _run(Xlat *x, Vm *vm, uint16_t keys, "
+        "uint32_t cyc) {\n"
+        "    Cpu         *cpu        = &vm->cpu;\n"
+        "    uint8_t     *v          = cpu->v_regs;\n"
+        "    uint8_t     *mem        = vm->ram.data;\n"
+        "    uint32_t    left        = cyc;\n"
+        "    uint8_t     f __attribute__((unused));\n\n"
+        "dispatch:\n    switch (cpu->pc) {\n");
+    for (uint16_t i = 0; i < cfg->blks_len; i++) {
+        fprintf(fp, "        case 0x%03x: goto L_%03x;\n", cfg->blks[i].start,
+            cfg->blks[i].start);
+    }
+    fprintf(fp, "        default: return cyc - left;\n    }\n");
+
+    for (uint16_t i = 0; i < cfg->blks_len; i++) {
+        blk = &cfg->blks[i];
+        len = (blk->end - blk->start) / 2;
+        fprintf(fp, "\nL_%03x:\n", blk->start);
+        if (_is_idle(ram, blk->start)) {
+            fprintf(fp, "    if (cpu->del_timer > 0) XLAT_EXIT(0x%03x, 0);\n",
+                blk->start);
+        } else if (_is_halt(ram, blk->start)) {
+            fprintf(fp, "    XLAT_EXIT(0x%03x, 0);\n", blk->start);
+        }
+        fprintf(fp, "    XLAT_ENTER(0x%03x, %u);\n", blk->start, len);
+        for (uint16_t j = 0; j < len; j++) {
+            instr = (ram->data[blk->start + j * 2] << 8) +
+                ram->data[blk->start + j * 2 + 1];
+            dis_op(instr, dis);
+            fprintf(fp, "    // %03x  %04x  %s\n", blk->start + j * 2, instr,
+                dis);
+            if (_emit_op(fp, cfg, blk->start + j * 2, instr, len - j,
+                    get_quirks(prof), &dispatch)) {
+                break;
+            }
+            if (j == len - 1) {
+                fprintf(fp, "    ");
+                _emit_goto(fp, cfg, blk->end, 0);
+                fprintf(fp, "\n");
+            }
+        }
+    }
+    if (!dispatch) {
+        fprintf(fp, "\n    goto dispatch;\n");
+    }
+    fprintf(fp, "}\n\nstatic const XlatProg _prog = {_run, _img, "
+        "sizeof(_img), %u, 0x%016" PRIx64 ", _code_map, %d};\n\n"
+        "int main(int argc, char *argv[]) {\n"
+        "    return main_xlat(&_prog, argc, argv);\n}\n", ram->prog_len,
+        cfg->hash, prof);
+}
+
+// Entry Point
+int main(int argc, char *argv[]) {
+    static Cfg  cfg;
+    static Ram  ram;
+    Err         err;
+    FILE        *fp;
+    int         curr_opt;
+    char        *out        = NULL;
+    char        *cfg_fn     = NULL;
+    QuirkProf   prof        = QUIRK_K8E;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, XLAT_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'a':
+            cfg_fn = optarg;
+            break;
+
+            case 'o':
+            out = optarg;
+            break;
+
+            case 'q':
+            if (!get_quirk_prof(optarg, &prof)) {
+                err.code = ERR_ARGV;
+                snprintf(err.msg, MAX_ERR_MSG_LEN, "Unknown quirk profile %s",
+                    optarg);
+                err_alert(&err);
+                return err.code;
+            }
+            break;
+
+            case 'h':
+            printf("k8e-xlat [-a ANALYSIS] [-o OUT.c] [-q QUIRKS] ROM\n");
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (optind != argc - 1) {
+        err.code = ERR_ARGV;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "1 positional argument expected, "
+            "but %d given", argc - optind);
+        err_alert(&err);
+        return err.code;
+    }
+
+    init_ram(&ram);
+    ld_ram_char(&ram);
+    ld_ram(&ram, argv[optind], &err);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+
+    // A saved analysis from k8e-analyze -o stands in for building one
+    if (cfg_fn != NULL) {
+        ld_cfg(&cfg, cfg_fn, &err);
+        if (!is_err(&err) && cfg.hash != ram.hash) {
+            err.code = ERR_DATA;
+            snprintf(err.msg, MAX_ERR_MSG_LEN, "Analysis %s is of another ROM",
+                cfg_fn);
+        }
+        if (is_err(&err)) {
+            err_alert(&err);
+            return err.code;
+        }
+    } else {
+        build_cfg(&cfg, &ram);
+    }
+
+    fp = out != NULL ? fopen(out, "w") : stdout;
+    if (fp == NULL) {
+        err.code = ERR_IO;
+        snprintf(err.msg, MAX_ERR_MSG_LEN, "Could not open file %s", out);
+        err_alert(&err);
+        return err.code;
+    }
+    _emit(fp, &cfg, &ram, argv[optind], prof);
+    if (fp != stdout) fclose(fp);
+    return ERR_OK;
+}
@@ -0,0 +1,32 @@
+// Copyright (C) 2024  KA Wright
+
+// trace.c - Binary execution trace
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ring.h"
+#include "trace.h"
+
+void open_trace(Trace *this, const char *fname, const Cpu *cpu, Err *err) {
+    TraceHdr hdr;
+
+    this->frame = 0;
+    open_ring(&this->ring, fname, TRACE_RING_SZ, err);
+    if (is_err(err)) return;
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.ver = TRACE_VER;
+    hdr.rec_sz = sizeof(TraceRec);
+    memcpy(hdr.v_regs, cpu->v_regs, sizeof(hdr.v_regs));
+    push_ring(&this->ring, &hdr, sizeof(hdr));
+}
+
+void tick_trace(Trace *this) {
+    this->frame++;
+}
+
+void close_trace(Trace *this, Err *err) {
+    close_ring(&this->ring, err);
+}
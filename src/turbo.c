@@ -0,0 +1,60 @@
+// Copyright (C) 2024  KA Wright
+
+// turbo.c - Fast-forward and uncapped speed
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "cpu.h"
+#include "timing.h"
+#include "turbo.h"
+#include "vm.h"
+
+void init_turbo(Turbo *this, uint8_t speed, uint16_t clk_freq, bool adaptive,
+        bool timed) {
+    this->speed     = speed;
+    this->ff_speed  = speed != 1 ? speed : TURBO_FF_SPEED;
+    this->clk_freq  = clk_freq;
+    this->cpf       = timed ? VIP_CPF : clk_freq / TURBO_TIMER_RATE;
+    this->cyc       = 0;
+    this->adaptive  = adaptive;
+    this->timed     = timed;
+    this->changed   = false;
+}
+
+void toggle_turbo(Turbo *this) {
+    this->speed = this->speed == 1 ? this->ff_speed : 1;
+    this->cyc = 0;
+    this->changed = true;
+}
+
+void skip_turbo_idle(Turbo *this, Vm *vm) {
+    if (!is_turbo_framed(this) || this->cyc + 1 >= this->cpf) return;
+
+    // Whole passes leave a timed loop as it was, spending the frame in it
+    if (this->timed) {
+        if (skip_vm_idle(vm, 3) > 0) this->cyc = this->cpf - 1;
+        return;
+    }
+    this->cyc += skip_vm_idle(vm, this->cpf - this->cyc - 1);
+}
+
+void charge_turbo_op(Turbo *this, const Cpu *cpu, uint16_t pc, uint8_t vx) {
+    if ((cpu->instr & 0xf000) == 0xd000 && this->cyc < this->cpf) {
+        this->cyc = this->cpf;
+    }
+    this->cyc += get_vip_cyc(cpu, pc, vx) - 1;
+}
+
+void start_turbo_clks(Turbo *this, Clk *sys_clk, Clk *timer_clk) {
+
+    // Scaling both clocks keeps the timers in step with the CPU. Adaptive
+    // and timed runs only wait on the system clock between frames.
+    init_clk(sys_clk, is_turbo_framed(this) ? TURBO_TIMER_RATE * this->speed :
+        (uint32_t) this->clk_freq * this->speed);
+    init_clk(timer_clk, TURBO_TIMER_RATE * this->speed);
+    start_clk(sys_clk);
+    start_clk(timer_clk);
+    this->changed = false;
+}
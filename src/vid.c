@@ -0,0 +1,57 @@
+// Copyright (C) 2024  KA Wright
+
+// vid.c - Video memory
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vid.h"
+
+void init_vid(Vid *this) {
+    clear_vid(this);
+}
+
+void clear_vid(Vid *this) {
+    for (uint8_t y = 0; y < VID_H; y++) {
+        this->rows[y] = 0;
+    }
+    this->dirty = true;
+}
+
+bool draw_vid(Vid *this, uint8_t x, uint8_t y, const uint8_t *spr, 
+        uint8_t n) {
+    uint64_t    mask;
+    uint64_t    hit         = 0;
+
+    x &= VID_W - 1;
+    for (uint8_t i = 0; i < n; i++) {
+        
+        // Rotate the sprite byte into place so columns wrap around
+        mask = (uint64_t) spr[i] << 56;
+        mask = (mask >> x) | (mask << ((VID_W - x) & (VID_W - 1)));
+        hit |= this->rows[(y + i) & (VID_H - 1)] & mask;
+        this->rows[(y + i) & (VID_H - 1)] ^= mask;
+    }
+    this->dirty = true;
+    return hit != 0;
+}
+
+bool draw_vid_clip(Vid *this, uint8_t x, uint8_t y, const uint8_t *spr,
+        uint8_t n) {
+    uint64_t    mask;
+    uint64_t    hit         = 0;
+
+    x &= VID_W - 1;
+    y &= VID_H - 1;
+    for (uint8_t i = 0; i < n && y + i < VID_H; i++) {
+        mask = ((uint64_t) spr[i] << 56) >> x;
+        hit |= this->rows[y + i] & mask;
+        this->rows[y + i] ^= mask;
+    }
+    this->dirty = true;
+    return hit != 0;
+}
+
+bool read_vid(const Vid *this, uint8_t x, uint8_t y) {
+    return (this->rows[y & (VID_H - 1)] >> (63 - (x & (VID_W - 1)))) & 1;
+}
@@ -0,0 +1,135 @@
+// Copyright (C) 2024  KA Wright
+
+// vm.c - Whole-machine state
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "ram.h"
+#include "vid.h"
+#include "vm.h"
+
+void init_vm(Vm *this) {
+    init_cpu(&this->cpu);
+    init_vid(&this->vid);
+    init_ram(&this->ram);
+    this->cow = NULL;
+}
+
+const Ram *read_vm_ram(const Vm *this) {
+    return this->cow != NULL ? this->cow : &this->ram;
+}
+
+void clone_vm(Vm *this, const Vm *src) {
+    if (src->cow != NULL) {
+        memcpy(this, src, offsetof(Vm, ram));
+        own_vm_ram(this);
+        return;
+    }
+    memcpy(this, src, sizeof(Vm));
+}
+
+void clone_vm_cow(Vm *this, const Vm *src) {
+    memcpy(this, src, offsetof(Vm, ram));
+    this->cow = read_vm_ram(src);
+    this->ram.prog_len = this->cow->prog_len;
+}
+
+void own_vm_ram(Vm *this) {
+    if (this->cow != NULL) {
+        memcpy(&this->ram, this->cow, sizeof(Ram));
+        this->cow = NULL;
+    }
+}
+
+void do_vm_op(Vm *this, uint16_t keys, Err *err) {
+    Ram         *ram        = &this->ram;
+    uint16_t    pc          = this->cpu.pc & ADDR_PROG_END;
+    uint16_t    instr;
+
+    if (this->cow != NULL) {
+        
+        // Only fx33 and fx55 write to RAM, so those end the sharing
+        instr = (this->cow->data[pc] << 8) + 
+            this->cow->data[(pc + 1) & ADDR_PROG_END];
+        if ((instr & 0xf0ff) == 0xf033 || (instr & 0xf0ff) == 0xf055) {
+            own_vm_ram(this);
+        } else {
+            ram = (Ram *) this->cow;
+        }
+    }
+    do_cpu_op(&this->cpu, ram, &this->vid, keys, err);
+}
+
+void tick_vm(Vm *this) {
+    if (this->cpu.del_timer > 0) this->cpu.del_timer--;
+    if (this->cpu.snd_timer > 0) this->cpu.snd_timer--;
+}
+
+// Match the spin waits at the pc of a Vm that can be skipped. Return data is
+// the number of instructions in the loop, or 0 if there is none.
+static uint8_t _match_idle(const Vm *this) {
+    const uint8_t   *data       = read_vm_ram(this)->data;
+    const Cpu       *cpu        = &this->cpu;
+    uint16_t        pc          = cpu->pc;
+    uint8_t         x;
+
+    if (cpu->paused || pc + 1 > ADDR_PROG_END) return 0;
+
+    // A jump to itself never leaves, whatever the timers do
+    if (data[pc] == (0x10 | pc >> 8) && data[pc + 1] == (pc & 0xff)) return 1;
+
+    // Look for fx07; 3x00; 1nnn, with the jump going back to the fx07
+    if (cpu->del_timer == 0 || pc + 5 > ADDR_PROG_END ||
+            (data[pc] & 0xf0) != 0xf0 || data[pc + 1] != 0x07) {
+        return 0;
+    }
+    x = data[pc] & 0xf;
+    if (data[pc + 2] != (0x30 | x) || data[pc + 3] != 0x00 ||
+            data[pc + 4] != (0x10 | pc >> 8) || data[pc + 5] != (pc & 0xff)) {
+        return 0;
+    }
+    return 3;
+}
+
+bool is_vm_idle(const Vm *this) {
+    return _match_idle(this) != 0;
+}
+
+uint32_t skip_vm_idle(Vm *this, uint32_t max) {
+    const uint8_t   *data       = read_vm_ram(this)->data;
+    Cpu             *cpu        = &this->cpu;
+    uint16_t        pc          = cpu->pc;
+    uint8_t         len         = max > 0 ? _match_idle(this) : 0;
+    uint8_t         last;
+
+    if (len == 0) return 0;
+    if (len == 1) {
+        cpu->instr = (data[pc] << 8) + data[pc + 1];
+        return max;
+    }
+
+    // The timer holds still until the next tick, so every pass loads the
+    // same nonzero value and only the position within the loop changes
+    last = ((max - 1) % 3) * 2;
+    cpu->v_regs[data[pc] & 0xf] = cpu->del_timer;
+    cpu->instr = (data[pc + last] << 8) + data[pc + last + 1];
+    cpu->pc = pc + (max % 3) * 2;
+    return max;
+}
+
+bool run_vm_frame(Vm *this, uint16_t keys, uint32_t cyc, Err *err) {
+    bool idle = false;
+
+    for (uint32_t i = 0; i < cyc; i++) {
+        idle = skip_vm_idle(this, cyc - i) > 0;
+        if (idle) break;
+        do_vm_op(this, keys, err);
+        if (is_err(err)) return false;
+    }
+    tick_vm(this);
+    return idle;
+}
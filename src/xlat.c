@@ -0,0 +1,129 @@
+// Copyright (C) 2024  KA Wright
+
+// xlat.c - Runtime for ROMs translated to C by k8e-xlat
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "err.h"
+#include "hash.h"
+#include "ram.h"
+#include "vm.h"
+#include "xlat.h"
+
+#define XLAT_OPTSTR             "c:f:hi"
+#define TIMER_RATE              60      // Hz
+
+void init_xlat(Xlat *this, const XlatProg *prog) {
+    this->prog  = prog;
+    this->smc   = false;
+}
+
+void run_xlat_frame(Xlat *this, Vm *vm, uint16_t keys, uint32_t cyc,
+        Err *err) {
+    uint32_t    i           = 0;
+    uint32_t    n;
+    uint16_t    op;
+    uint16_t    addr;
+    uint16_t    len;
+
+    own_vm_ram(vm);
+    while (true) {
+        if (skip_vm_idle(vm, cyc - i) > 0) break;
+        n = this->prog->fn(this, vm, keys, cyc - i);
+        i += n;
+        if (i >= cyc) break;
+
+        // Translated code leaves spin waits early, so look for one first
+        if (n > 0) continue;
+        do_vm_op(vm, keys, err);
+        if (is_err(err)) return;
+        i++;
+
+        // The interpreter may write over translated code too
+        op = vm->cpu.instr & 0xf0ff;
+        if (!this->smc && (op == 0xf033 || op == 0xf055)) {
+            len = op == 0xf033 ? 3 : ((vm->cpu.instr >> 8) & 0xf) + 1;
+            addr = vm->cpu.i_reg;
+            if (op == 0xf055 && get_quirks(vm->cpu.quirks) & QUIRK_MEM_INC_I) {
+                addr -= len;
+            }
+            this->smc = is_xlat_code(this->prog, addr, len);
+        }
+        if (i >= cyc) break;
+    }
+    tick_vm(vm);
+}
+
+int main_xlat(const XlatProg *prog, int argc, char *argv[]) {
+    static Vm   vm;
+    Xlat        xlat;
+    Err         err;
+    int         curr_opt;
+    uint32_t    frames      = 600;
+    uint16_t    freq        = 500;
+    bool        interp      = false;
+    struct timespec start;
+    struct timespec end;
+
+    init_err(&err);
+    while ((curr_opt = getopt(argc, argv, XLAT_OPTSTR)) != -1) {
+        switch (curr_opt) {
+
+            case 'c':
+            freq = (uint16_t) strtol(optarg, NULL, 10);
+            break;
+
+            case 'f':
+            frames = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+
+            case 'i':
+            interp = true;
+            break;
+
+            case 'h':
+            printf("%s [-c FREQ] [-f FRAMES] [-i]\n", argv[0]);
+            return ERR_OK;
+
+            default:
+            return ERR_ARGV;
+        }
+    }
+    if (freq < TIMER_RATE) {
+        err.code = ERR_ARGV;
+        strcpy(err.msg, "Expected a frequency of 60 or more");
+        err_alert(&err);
+        return err.code;
+    }
+
+    init_vm(&vm);
+    ld_ram_char(&vm.ram);
+    ld_ram_buf(&vm.ram, prog->img, prog->rom_len, &err);
+    vm.cpu.quirks = prog->quirks;
+    init_xlat(&xlat, prog);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < frames && !is_err(&err); i++) {
+        if (interp) {
+            run_vm_frame(&vm, 0, freq / TIMER_RATE, &err);
+        } else {
+            run_xlat_frame(&xlat, &vm, 0, freq / TIMER_RATE, &err);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (is_err(&err)) {
+        err_alert(&err);
+        return err.code;
+    }
+    printf("VID %016" PRIx64 "  CPU %016" PRIx64 "  (%.3f ms)\n",
+        hash_vid(&vm.vid), hash_cpu(&vm.cpu), (end.tv_sec - start.tv_sec) *
+        1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    return ERR_OK;
+}